@@ -0,0 +1,243 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "BoundingBox.h"
+#include "Ray.h"
+#include "ray_stats.h"
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+// Node of a flattened binary BVH. Children of an interior node are stored next
+// to each other so a single index is enough to find both.
+struct BVHNode
+{
+  BoundingBox box;
+  // Interior node: index of the left child (the right child is first+1).
+  // Leaf: offset of the first primitive in BVH::indices.
+  int first = 0;
+  // Number of primitives in a leaf, 0 for interior nodes.
+  int count = 0;
+  bool is_leaf() const { return count > 0; }
+};
+
+// How a BVH is built, trading tree quality for build time:
+//   median  split at the median centroid along the widest axis
+//   sah  binned surface area heuristic; the best trees, the default
+//   linear  Morton-code sort and radix tree; several times faster to build
+//     than sah at some cost in traversal, for geometry rebuilt every edit
+enum class BVHBuild
+{
+  median,
+  sah,
+  linear
+};
+// Name of a build method ("median", "sah" or "linear")
+const char * bvh_build_name(const BVHBuild method);
+// Parse a build method name.
+//
+// Returns false (leaving method untouched) for unknown names
+bool parse_bvh_build(const std::string & name, BVHBuild & method);
+
+// Bounding volume hierarchy over an abstract list of primitives, each known
+// only by its id and its bounding box. Meshes build one over their triangles
+// and scenes build one over their objects, giving a two-level hierarchy.
+class BVH
+{
+  public:
+    // nodes[0] is the root (if any)
+    std::vector<BVHNode> nodes;
+    // Primitive ids ordered so that each leaf owns a contiguous range
+    std::vector<int> indices;
+    // Build the hierarchy top-down, splitting large ranges in parallel
+    // (OpenMP tasks).
+    //
+    // Inputs:
+    //   boxes  #primitives list of (finite) primitive bounding boxes
+    //   leaf_size  maximum number of primitives per leaf
+    //   method  how to choose splits
+    void build(
+      const std::vector<BoundingBox> & boxes,
+      const int leaf_size = 4,
+      const BVHBuild method = BVHBuild::sah);
+    // Recompute node bounds bottom-up for moved primitives, keeping the tree
+    // topology. Much cheaper than build, but the tree degrades as primitives
+    // move far from where they were when it was built (see sah_cost).
+    //
+    // Inputs:
+    //   boxes  list of primitive bounding boxes indexed by primitive id
+    void refit(const std::vector<BoundingBox> & boxes);
+    // Surface area heuristic cost of the tree relative to its root area
+    // (expected number of node visits plus primitive tests for a random ray).
+    double sah_cost() const;
+    bool empty() const { return nodes.empty(); }
+    // Bounds of everything in the hierarchy
+    BoundingBox bounding_box() const
+    {
+      return nodes.empty() ? BoundingBox() : nodes[0].box;
+    }
+    // Visit primitives whose boxes the ray passes through in front-to-back
+    // order, skipping any subtree that starts beyond the closest hit so far.
+    //
+    // Inputs:
+    //   ray  ray to intersect with
+    //   min_t  minimum parametric distance to consider
+    //   max_t  current closest hit (e.g., infinity)
+    //   intersect_primitive  callable bool(int id, double & max_t) that tests
+    //     primitive id and, if it is hit closer than max_t, records the hit,
+    //     lowers max_t and returns true
+    // Outputs:
+    //   max_t  parametric distance to the closest hit found
+    // Returns true iff any primitive reported a hit
+    template <typename PrimitiveIntersector>
+    bool intersect(
+      const Ray & ray,
+      const double min_t,
+      double & max_t,
+      PrimitiveIntersector && intersect_primitive) const;
+    // Same traversal, but whole leaves are handed to the caller (e.g., to test
+    // their primitives as a batch).
+    //
+    // Inputs:
+    //   intersect_leaf  callable bool(int first, int count, double & max_t)
+    //     that tests primitives indices[first,first+count) like
+    //     intersect_primitive above
+    template <typename LeafIntersector>
+    bool intersect_leaves(
+      const Ray & ray,
+      const double min_t,
+      double & max_t,
+      LeafIntersector && intersect_leaf) const;
+    // Visit the primitives of every leaf whose node boxes all pass a
+    // (conservative) overlap test, stopping at the first primitive accepted.
+    //
+    // Inputs:
+    //   overlaps  callable bool(const BoundingBox &) that returns false only
+    //     if nothing in the box can matter
+    //   accept  callable bool(int id) that tests primitive id
+    // Returns true iff accept returned true for some primitive
+    template <typename BoxTest, typename Visitor>
+    bool any_of(BoxTest && overlaps, Visitor && accept) const;
+};
+
+// Implementation
+
+template <typename PrimitiveIntersector>
+inline bool BVH::intersect(
+  const Ray & ray,
+  const double min_t,
+  double & max_t,
+  PrimitiveIntersector && intersect_primitive) const
+{
+  return intersect_leaves(ray,min_t,max_t,
+    [&](const int first, const int count, double & leaf_max_t)->bool
+    {
+      bool hit = false;
+      for(int i = first;i<first+count;i++)
+      {
+        hit |= intersect_primitive(indices[i],leaf_max_t);
+      }
+      return hit;
+    });
+}
+
+template <typename LeafIntersector>
+inline bool BVH::intersect_leaves(
+  const Ray & ray,
+  const double min_t,
+  double & max_t,
+  LeafIntersector && intersect_leaf) const
+{
+  if(nodes.empty()) return false;
+  const Eigen::Vector3d inv_direction = ray.direction.cwiseInverse();
+  double t_enter;
+  if(!ray_intersect_box(ray.origin,inv_direction,nodes[0].box,min_t,max_t,t_enter))
+  {
+    return false;
+  }
+  bool hit = false;
+  // Counted locally and reported once per traversal
+  uint64_t visits = 0;
+  uint64_t early_outs = 0;
+  // build keeps trees well under 64 levels deep
+  struct Entry { int node; double t_enter; };
+  Entry stack[64];
+  int top = 0;
+  stack[top++] = {0,t_enter};
+  while(top > 0)
+  {
+    const Entry entry = stack[--top];
+    // A closer hit may have been found since this node was pushed
+    if(entry.t_enter > max_t)
+    {
+      early_outs++;
+      continue;
+    }
+    visits++;
+    const BVHNode & node = nodes[entry.node];
+    if(node.is_leaf())
+    {
+      hit |= intersect_leaf(node.first,node.count,max_t);
+      continue;
+    }
+    double t_left, t_right;
+    const int hits = ray_intersect_box_pair(ray.origin,inv_direction,
+      nodes[node.first].box,nodes[node.first+1].box,min_t,max_t,
+      t_left,t_right);
+    const bool hit_left = hits & 1;
+    const bool hit_right = hits & 2;
+    // Push the far child first so the near one is visited first
+    if(hit_left && hit_right)
+    {
+      if(t_left <= t_right)
+      {
+        stack[top++] = {node.first+1,t_right};
+        stack[top++] = {node.first,t_left};
+      }else
+      {
+        stack[top++] = {node.first,t_left};
+        stack[top++] = {node.first+1,t_right};
+      }
+    }else if(hit_left)
+    {
+      stack[top++] = {node.first,t_left};
+    }else if(hit_right)
+    {
+      stack[top++] = {node.first+1,t_right};
+    }
+  }
+  count_ray_stat(RayCounter::bvh_node_visits,visits);
+  count_ray_stat(RayCounter::early_outs,early_outs);
+  return hit;
+}
+
+template <typename BoxTest, typename Visitor>
+inline bool BVH::any_of(BoxTest && overlaps, Visitor && accept) const
+{
+  if(nodes.empty() || !overlaps(nodes[0].box)) return false;
+  int stack[64];
+  int top = 0;
+  stack[top++] = 0;
+  while(top > 0)
+  {
+    const BVHNode & node = nodes[stack[--top]];
+    if(node.is_leaf())
+    {
+      for(int i = node.first;i<node.first+node.count;i++)
+      {
+        if(accept(indices[i])) return true;
+      }
+      continue;
+    }
+    for(int c = node.first;c<node.first+2;c++)
+    {
+      if(overlaps(nodes[c].box))
+      {
+        stack[top++] = c;
+      }
+    }
+  }
+  return false;
+}
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef BEAM_H
+#define BEAM_H
+
+#include "BoundingBox.h"
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <array>
+#include <cmath>
+
+// Pyramid of rays from an apex (the eye) through a planar quad, the
+// footprint, where every ray of the pyramid ends. The coarse visibility pass
+// uses beams to prove that a block of pixels sees nothing but one plane.
+//
+// The inside of the beam is the part of the pyramid strictly in front of the
+// footprint plane, so surfaces lying in that plane are never inside.
+struct Beam
+{
+  Eigen::Vector3d apex;
+  // Footprint corners in order around the quad (all in one plane)
+  std::array<Eigen::Vector3d,4> footprint;
+  // Unit normal of the footprint plane, pointing away from the apex
+  Eigen::Vector3d normal;
+  // Points closer than this to the footprint plane count as lying in it
+  double tolerance = 0;
+  // Bounding planes (4 sides, then the footprint plane moved tolerance toward
+  // the apex) as (n,d) with n.x + d <= 0 inside
+  std::array<Eigen::Vector4d,5> planes;
+  Beam() = default;
+  // Inputs:
+  //   apex  common origin of the rays
+  //   footprint  corners of a planar, convex quad in order around it
+  Beam(const Eigen::Vector3d & apex, const std::array<Eigen::Vector3d,4> & footprint);
+  // The same beam in another coordinate system (e.g., an Instance's object
+  // space)
+  Beam transformed(const Eigen::Affine3d & T) const
+  {
+    return Beam(T*apex,{T*footprint[0],T*footprint[1],T*footprint[2],T*footprint[3]});
+  }
+  // Signed distance of p from the footprint plane (positive beyond it)
+  double plane_distance(const Eigen::Vector3d & p) const
+  {
+    return normal.dot(p-footprint[0]);
+  }
+  // Conservative separation tests: true only if the box/triangle is certainly
+  // outside the beam
+  bool outside(const BoundingBox & box) const;
+  bool outside(
+    const Eigen::Vector3d & a,
+    const Eigen::Vector3d & b,
+    const Eigen::Vector3d & c) const;
+  // Whether the triangle lies in the footprint plane and contains the whole
+  // footprint, so that every ray of the beam hits it
+  bool covered_by(
+    const Eigen::Vector3d & a,
+    const Eigen::Vector3d & b,
+    const Eigen::Vector3d & c) const;
+};
+
+// Implementation
+
+inline Beam::Beam(
+  const Eigen::Vector3d & a_apex,
+  const std::array<Eigen::Vector3d,4> & a_footprint)
+  : apex(a_apex), footprint(a_footprint)
+{
+  const Eigen::Vector3d center =
+    0.25*(footprint[0]+footprint[1]+footprint[2]+footprint[3]);
+  normal =
+    (footprint[2]-footprint[0]).cross(footprint[3]-footprint[1]).normalized();
+  if(normal.dot(center-apex) < 0)
+  {
+    normal = -normal;
+  }
+  // Relative to the size of the beam; mesh vertices are single precision
+  double extent = 0;
+  for(const Eigen::Vector3d & p : footprint)
+  {
+    extent = std::max(extent,(p-apex).norm());
+  }
+  tolerance = 1e-5*(1.0+extent);
+  for(int k = 0;k<4;k++)
+  {
+    Eigen::Vector3d n =
+      (footprint[k]-apex).cross(footprint[(k+1)%4]-apex);
+    if(n.dot(center-apex) > 0)
+    {
+      n = -n;
+    }
+    planes[k] << n, -n.dot(apex);
+  }
+  planes[4] << normal, -normal.dot(footprint[0]) + tolerance;
+}
+
+inline bool Beam::outside(const BoundingBox & box) const
+{
+  if(box.empty())
+  {
+    return true;
+  }
+  if(!box.is_finite())
+  {
+    return false;
+  }
+  for(const Eigen::Vector4d & plane : planes)
+  {
+    // Corner of the box furthest inside this plane
+    const Eigen::Vector3d p(
+      plane(0) > 0 ? box.min_corner.x() : box.max_corner.x(),
+      plane(1) > 0 ? box.min_corner.y() : box.max_corner.y(),
+      plane(2) > 0 ? box.min_corner.z() : box.max_corner.z());
+    if(plane.head<3>().dot(p) + plane(3) > 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool Beam::outside(
+  const Eigen::Vector3d & a,
+  const Eigen::Vector3d & b,
+  const Eigen::Vector3d & c) const
+{
+  // Clip the triangle by each plane in turn (large triangles may straddle
+  // every plane and still miss the beam). Each plane adds at most one vertex.
+  std::array<Eigen::Vector3d,8> polygon = {a,b,c};
+  std::array<Eigen::Vector3d,8> clipped;
+  int count = 3;
+  for(const Eigen::Vector4d & plane : planes)
+  {
+    const auto distance = [&](const Eigen::Vector3d & p)
+    {
+      return plane.head<3>().dot(p) + plane(3);
+    };
+    int kept = 0;
+    for(int k = 0;k<count;k++)
+    {
+      const Eigen::Vector3d & p = polygon[k];
+      const Eigen::Vector3d & q = polygon[(k+1)%count];
+      const double dp = distance(p);
+      const double dq = distance(q);
+      if(dp <= 0)
+      {
+        clipped[kept++] = p;
+      }
+      if((dp <= 0) != (dq <= 0))
+      {
+        clipped[kept++] = p + dp/(dp-dq)*(q-p);
+      }
+    }
+    if(kept == 0)
+    {
+      return true;
+    }
+    polygon = clipped;
+    count = kept;
+  }
+  return false;
+}
+
+inline bool Beam::covered_by(
+  const Eigen::Vector3d & a,
+  const Eigen::Vector3d & b,
+  const Eigen::Vector3d & c) const
+{
+  if(std::abs(plane_distance(a)) > tolerance ||
+     std::abs(plane_distance(b)) > tolerance ||
+     std::abs(plane_distance(c)) > tolerance)
+  {
+    return false;
+  }
+  // Each footprint corner must be on the inner side of all three edges
+  const Eigen::Vector3d corners[3] = {a,b,c};
+  const double orientation = normal.dot((b-a).cross(c-a)) > 0 ? 1.0 : -1.0;
+  for(int e = 0;e<3;e++)
+  {
+    const Eigen::Vector3d & p = corners[e];
+    const Eigen::Vector3d edge = corners[(e+1)%3]-p;
+    for(const Eigen::Vector3d & q : footprint)
+    {
+      if(orientation*normal.dot(edge.cross(q-p)) < 0)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+#endif
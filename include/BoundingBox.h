@@ -0,0 +1,141 @@
+#ifndef BOUNDING_BOX_H
+#define BOUNDING_BOX_H
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define BOUNDING_BOX_SSE
+#endif
+
+// Axis-aligned bounding box. A default constructed box is empty (min_corner
+// at +inf, max_corner at -inf) so that extending it by anything yields that
+// thing's bounds.
+struct BoundingBox
+{
+  Eigen::Vector3d min_corner;
+  Eigen::Vector3d max_corner;
+  BoundingBox(
+    const Eigen::Vector3d & a_min_corner = Eigen::Vector3d::Constant(
+      std::numeric_limits<double>::infinity()),
+    const Eigen::Vector3d & a_max_corner = Eigen::Vector3d::Constant(
+      -std::numeric_limits<double>::infinity()))
+    : min_corner(a_min_corner), max_corner(a_max_corner) {}
+  // Box covering all of space (e.g., for infinite planes)
+  static BoundingBox infinite()
+  {
+    return BoundingBox(
+      Eigen::Vector3d::Constant(-std::numeric_limits<double>::infinity()),
+      Eigen::Vector3d::Constant(std::numeric_limits<double>::infinity()));
+  }
+  Eigen::Vector3d center() const { return 0.5*(min_corner+max_corner); }
+  bool empty() const { return (min_corner.array() > max_corner.array()).any(); }
+  // True iff the box is non-empty and all of its corners are finite
+  bool is_finite() const
+  {
+    return !empty() && min_corner.allFinite() && max_corner.allFinite();
+  }
+  void extend(const Eigen::Vector3d & p)
+  {
+    min_corner = min_corner.cwiseMin(p);
+    max_corner = max_corner.cwiseMax(p);
+  }
+  void extend(const BoundingBox & B)
+  {
+    min_corner = min_corner.cwiseMin(B.min_corner);
+    max_corner = max_corner.cwiseMax(B.max_corner);
+  }
+  double surface_area() const
+  {
+    if(empty()) return 0;
+    const Eigen::Vector3d e = max_corner-min_corner;
+    return 2.0*(e.x()*e.y() + e.y()*e.z() + e.z()*e.x());
+  }
+};
+
+// Intersect a ray with a box using the slab test.
+//
+// Inputs:
+//   origin  ray origin
+//   inv_direction  component-wise reciprocal of the ray direction
+//   box  box to intersect against
+//   min_t  minimum parametric distance to consider
+//   max_t  maximum parametric distance to consider
+// Outputs:
+//   t_enter  parametric distance where the ray enters the box (clamped to
+//     min_t)
+// Returns true iff the ray overlaps the box somewhere in [min_t,max_t]
+inline bool ray_intersect_box(
+  const Eigen::Vector3d & origin,
+  const Eigen::Vector3d & inv_direction,
+  const BoundingBox & box,
+  const double min_t,
+  const double max_t,
+  double & t_enter)
+{
+  double t0 = min_t;
+  double t1 = max_t;
+  for(int a = 0;a<3;a++)
+  {
+    double ta = (box.min_corner(a)-origin(a))*inv_direction(a);
+    double tb = (box.max_corner(a)-origin(a))*inv_direction(a);
+    if(ta > tb) std::swap(ta,tb);
+    // Written so that NaNs (0*inf for axis-aligned rays on a slab boundary)
+    // leave the interval untouched.
+    t0 = ta > t0 ? ta : t0;
+    t1 = tb < t1 ? tb : t1;
+  }
+  t_enter = t0;
+  return t0 <= t1;
+}
+
+// Slab test of a ray against two boxes at once (e.g., the two children of a
+// BVH node), one SSE2 lane per box. Same results as two ray_intersect_box
+// calls, NaN handling included.
+//
+// Inputs:
+//   origin  ray origin
+//   inv_direction  component-wise reciprocal of the ray direction
+//   box_a,box_b  boxes to intersect against
+//   min_t,max_t  interval to clip to
+// Outputs:
+//   t_a,t_b  entry distances (as t_enter above)
+// Returns bit 0 set iff box_a is hit, bit 1 set iff box_b is hit
+inline int ray_intersect_box_pair(
+  const Eigen::Vector3d & origin,
+  const Eigen::Vector3d & inv_direction,
+  const BoundingBox & box_a,
+  const BoundingBox & box_b,
+  const double min_t,
+  const double max_t,
+  double & t_a,
+  double & t_b)
+{
+#ifdef BOUNDING_BOX_SSE
+  __m128d t0 = _mm_set1_pd(min_t);
+  __m128d t1 = _mm_set1_pd(max_t);
+  for(int a = 0;a<3;a++)
+  {
+    const __m128d o = _mm_set1_pd(origin(a));
+    const __m128d inv = _mm_set1_pd(inv_direction(a));
+    const __m128d ta = _mm_mul_pd(_mm_sub_pd(
+      _mm_set_pd(box_b.min_corner(a),box_a.min_corner(a)),o),inv);
+    const __m128d tb = _mm_mul_pd(_mm_sub_pd(
+      _mm_set_pd(box_b.max_corner(a),box_a.max_corner(a)),o),inv);
+    // minpd/maxpd return their second operand unless the comparison holds:
+    // this is the swap above followed by its two NaN-safe selects
+    t0 = _mm_max_pd(_mm_min_pd(tb,ta),t0);
+    t1 = _mm_min_pd(_mm_max_pd(ta,tb),t1);
+  }
+  t_a = _mm_cvtsd_f64(t0);
+  t_b = _mm_cvtsd_f64(_mm_unpackhi_pd(t0,t0));
+  return _mm_movemask_pd(_mm_cmple_pd(t0,t1));
+#else
+  return
+    (ray_intersect_box(origin,inv_direction,box_a,min_t,max_t,t_a) ? 1 : 0) |
+    (ray_intersect_box(origin,inv_direction,box_b,min_t,max_t,t_b) ? 2 : 0);
+#endif
+}
+
+#endif
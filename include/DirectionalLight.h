@@ -2,7 +2,8 @@
 #define DIRECTIONALLIGHT_H
 #include "Light.h"
 #include <Eigen/Core>
-class DirectionalLight : public Light
+#include <limits>
+class DirectionalLight final : public Light
 {
   public:
     // Direction _from_ light toward scene.
@@ -17,6 +18,16 @@ class DirectionalLight : public Light
     void direction(
       const Eigen::Vector3d & q, Eigen::Vector3d & d, double & max_t) const;
 };
+
+// Implementation (in the header so it inlines wherever the light's type is
+// known, with or without LTO)
+
+inline void DirectionalLight::direction(
+  const Eigen::Vector3d & /*q*/, Eigen::Vector3d & d, double & max_t) const
+{
+  d = -this->d;
+  max_t = std::numeric_limits<double>::infinity();
+}
 #endif
 
 
@@ -0,0 +1,32 @@
+#ifndef FRAME_ACCUMULATOR_H
+#define FRAME_ACCUMULATOR_H
+
+#include "render_frame.h"
+#include <vector>
+
+// Running average of frames of the same view rendered with different seeds
+// (jittered pixel positions, area-light samples). Each pass makes the image
+// converge further toward its antialiased, noise-free limit.
+class FrameAccumulator
+{
+  public:
+    // Forget all passes
+    void reset();
+    // Blend a frame into the average, starting over if its size differs.
+    //
+    // Inputs:
+    //   frame  next pass of the view
+    // Returns the tone-mapped average (with frame's stats and heat scale)
+    RenderResult add(const LinearFrame & frame);
+    // Average so far as linear radiance
+    LinearFrame average() const;
+    // Number of frames in the average
+    int passes() const { return count; }
+  private:
+    std::vector<float> sum;
+    int width = 0;
+    int height = 0;
+    int count = 0;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Background thread that writes frames with write_ppm so a renderer can
+// stream image sequences to disk without waiting on the file system.
+// Frames are written in submission order.
+class FrameWriter
+{
+  public:
+    // Inputs:
+    //   max_pending  number of queued frames before write() blocks (keeps
+    //     memory bounded when the disk is slower than the renderer)
+    explicit FrameWriter(size_t max_pending = 4);
+    FrameWriter(const FrameWriter &) = delete;
+    FrameWriter & operator=(const FrameWriter &) = delete;
+    // Writes any queued frames before returning
+    ~FrameWriter();
+    // Queue a frame for writing. Takes ownership of the pixel data.
+    //
+    // Inputs:
+    //   filename  path to .ppm file as string
+    //   data  width*height*num_channels array of image intensity data
+    //   width  image width
+    //   height  image height
+    //   num_channels  3 for rgb, 1 for grayscale
+    void write(
+      const std::string & filename,
+      std::vector<unsigned char> && data,
+      const int width,
+      const int height,
+      const int num_channels);
+    // Block until every queued frame has been written.
+    //
+    // Returns number of frames that failed to write so far
+    int flush();
+  private:
+    struct Frame
+    {
+      std::string filename;
+      std::vector<unsigned char> data;
+      int width;
+      int height;
+      int num_channels;
+    };
+    void run();
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::condition_variable drained;
+    std::deque<Frame> frames;
+    size_t max_pending;
+    // Frame currently being written by the worker
+    bool busy = false;
+    bool stopping = false;
+    int failures = 0;
+    std::thread worker;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef GEOMETRY_PAGER_H
+#define GEOMETRY_PAGER_H
+
+#include "PackedMesh.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Loads .stl meshes (and builds their BVHs) on demand on a background thread
+// and keeps the most recently hit ones resident under a memory cap.
+//
+// add() must be called before rendering starts; acquire() may then be called
+// from any number of threads at once. Lookups are a plain atomic pointer load
+// (no reference counting on the hot path), so evicted meshes are only freed
+// by the following next_frame(): all rays of a frame must be done before the
+// next frame starts, which holds for the batch loop and for the window (one
+// render in flight at a time).
+class GeometryPager
+{
+  public:
+    // Inputs:
+    //   memory_cap  bytes of resident geometry (vertices, faces, BVH) to aim
+    //     for. Meshes hit during the current frame are never evicted, so a
+    //     frame that sees more than this exceeds it until the view moves.
+    explicit GeometryPager(size_t memory_cap);
+    GeometryPager(const GeometryPager &) = delete;
+    GeometryPager & operator=(const GeometryPager &) = delete;
+    // Abandons queued loads and waits for the one in progress
+    ~GeometryPager();
+    // Register an .stl file without loading it.
+    //
+    // Inputs:
+    //   filename  path to the .stl file
+    //   method  how to build its BVH once loaded
+    //   normals  how to shade it (see PackedMesh::compute_normals)
+    //   corner_threshold  smoothing angle in degrees for per_corner normals
+    // Returns handle of the mesh
+    int add(
+      const std::string & filename,
+      const BVHBuild method = BVHBuild::sah,
+      const MeshNormals normals = MeshNormals::flat,
+      const double corner_threshold = 20.0);
+    // Resident mesh of a handle, marking it as hit in the current frame. A
+    // mesh that is not resident is queued for loading and nullptr is
+    // returned until it is. Meshes that fail to load become empty.
+    const PackedMesh * acquire(const int handle);
+    // Resident mesh of a handle (or nullptr) without marking or queueing it
+    const PackedMesh * resident_mesh(const int handle) const
+    {
+      return slots[handle].mesh.load(std::memory_order_acquire);
+    }
+    // Start a new frame: advances the least-recently-hit clock and frees the
+    // meshes evicted during the previous one
+    void next_frame();
+    // Block until no loads are queued or running.
+    //
+    // Returns number of loads completed so far
+    uint64_t wait_idle();
+    // Number of loads completed so far (changes whenever meshes appear)
+    uint64_t loads() const { return completed; }
+    // Bytes of geometry (including BVHs and normals) currently resident
+    size_t resident_bytes() const { return resident; }
+  private:
+    enum State { unloaded, queued, resident_state };
+    struct Slot
+    {
+      std::string filename;
+      BVHBuild method = BVHBuild::sah;
+      MeshNormals normals = MeshNormals::flat;
+      double corner_threshold = 20.0;
+      // Resident mesh (owned by `owner`), read without locking
+      std::atomic<const PackedMesh *> mesh{nullptr};
+      std::shared_ptr<const PackedMesh> owner;
+      std::atomic<int> state{unloaded};
+      // Frame in which the mesh was last hit
+      std::atomic<uint64_t> last_hit{0};
+      size_t bytes = 0;
+    };
+    void run();
+    // Drop least-recently-hit meshes until the resident set fits the cap
+    // (called with mutex held)
+    void evict(const int keep);
+    std::deque<Slot> slots;
+    size_t memory_cap;
+    std::atomic<uint64_t> frame{1};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<size_t> resident{0};
+    std::mutex mutex;
+    std::condition_variable requested;
+    std::condition_variable idle;
+    std::deque<int> pending;
+    // Evicted meshes and the frame they were evicted in
+    std::vector<std::pair<uint64_t,std::shared_ptr<const PackedMesh> > > retired;
+    bool busy = false;
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif
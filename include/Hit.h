@@ -0,0 +1,25 @@
+#ifndef HIT_H
+#define HIT_H
+
+class PackedMesh;
+
+// Where a ray first hits an object, as found by Object::closest_hit: enough
+// to compute the surface there later (Object::surface_normal), which is only
+// done for the closest hit over all objects.
+struct Hit
+{
+  // Parametric distance along the ray
+  double t;
+  // Primitive of the object that was hit (e.g., the triangle of a mesh), as
+  // the object defines it
+  int primitive = 0;
+  // Barycentric coordinates of the hit in a triangle primitive: the weights
+  // of its second and third corners
+  double u = 0;
+  double v = 0;
+  // Mesh that was hit, for objects that only reach their mesh indirectly and
+  // may lose it before the normal is computed (see LazyMesh)
+  const PackedMesh * mesh = nullptr;
+};
+
+#endif
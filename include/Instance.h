@@ -0,0 +1,52 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "Object.h"
+#include "PackedMesh.h"
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <memory>
+
+// A placement of shared mesh geometry in the scene: an object-to-world
+// transform plus a reference to a PackedMesh (and therefore its BVH). Any
+// number of instances may point at the same mesh without copying it.
+class Instance : public Object
+{
+  public:
+    std::shared_ptr<const PackedMesh> mesh;
+    Instance(
+      const std::shared_ptr<const PackedMesh> & a_mesh = nullptr,
+      const Eigen::Affine3d & a_transform = Eigen::Affine3d::Identity());
+    // Set the object-to-world transform (and its cached inverse).
+    void set_transform(const Eigen::Affine3d & a_transform);
+    const Eigen::Affine3d & transform() const { return object_to_world; }
+    // Intersect the instance with a (world-space) ray by transforming the ray
+    // into object space. The direction is not renormalized so t (and the
+    // bounds on it) are the same in both spaces.
+    //
+    // Inputs:
+    //   Ray  ray to intersect with
+    //   min_t  minimum parametric distance to consider
+    //   max_t  parametric distance at and beyond which hits are ignored
+    // Outputs:
+    //   hit  first intersection (see PackedMesh::closest_hit)
+    // Returns iff there a first intersection is found.
+    bool closest_hit(
+      const Ray & ray,
+      const double min_t,
+      const double max_t,
+      Hit & hit) const;
+    // World-space unit normal at the hit, facing the ray
+    Eigen::Vector3d surface_normal(const Ray & ray, const Hit & hit) const;
+    // World-space bounds of the transformed mesh bounds
+    BoundingBox bounding_box() const;
+    // Beam queries against the mesh, in object space
+    bool intersects_beam(const Beam & beam) const;
+    bool covers_beam(const Beam & beam) const;
+  private:
+    Ray to_object(const Ray & ray) const;
+    Eigen::Affine3d object_to_world;
+    Eigen::Affine3d world_to_object;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef LAZY_MESH_H
+#define LAZY_MESH_H
+
+#include "GeometryPager.h"
+#include "Object.h"
+#include <Eigen/Core>
+#include <memory>
+
+// Stand-in for mesh geometry paged in by a GeometryPager: only the mesh's
+// bounds are known up front. The first ray that reaches the object queues
+// its mesh for loading; until the mesh is resident, rays hit its bounding box
+// instead, so the object shows (and casts shadows) as a box in its material.
+//
+// Paging changes what intersect returns over time without the object itself
+// changing, so renders that must be exact wait for the pager to go idle and
+// render again (see GeometryPager::wait_idle).
+class LazyMesh : public Object
+{
+  public:
+    LazyMesh(
+      const std::shared_ptr<GeometryPager> & a_pager,
+      const int a_handle,
+      const BoundingBox & a_bounds);
+    // Intersect the mesh, or its bounding box while it is not resident.
+    //
+    // Inputs:
+    //   Ray  ray to intersect with
+    //   min_t  minimum parametric distance to consider
+    //   max_t  parametric distance at and beyond which hits are ignored
+    // Outputs:
+    //   hit  first intersection: a mesh hit (see PackedMesh::closest_hit)
+    //     with hit.mesh set to the mesh, or a box hit with primitive -1-axis
+    //     of the face and no mesh
+    // Returns iff there a first intersection is found.
+    bool closest_hit(
+      const Ray & ray,
+      const double min_t,
+      const double max_t,
+      Hit & hit) const;
+    // Normal of the mesh, or of the box face, at the hit. The mesh is the one
+    // recorded in the hit rather than looked up again: the pager may evict it
+    // in between, but keeps it alive until the next frame.
+    Eigen::Vector3d surface_normal(const Ray & ray, const Hit & hit) const;
+    BoundingBox bounding_box() const { return bounds; }
+    // Beam queries against the mesh if it is resident, else against the
+    // placeholder box. They never page anything in.
+    bool intersects_beam(const Beam & beam) const;
+    bool covers_beam(const Beam & beam) const;
+  private:
+    std::shared_ptr<GeometryPager> pager;
+    int handle;
+    BoundingBox bounds;
+};
+
+#endif
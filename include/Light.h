@@ -19,5 +19,25 @@ class Light
       const Eigen::Vector3d & q, 
       Eigen::Vector3d & d, 
       double & max_t) const =0;
+    // Direction toward a point on the light chosen by a sample in [0,1)^2.
+    // Lights without area (the default) ignore the sample.
+    //
+    // Input:
+    //   q  3D query point in space
+    //   u,v  sample coordinates in [0,1)
+    // Outputs:
+    //    d  3D direction from point toward the sampled point as a vector.
+    //    max_t  parametric distance from q along d to light (may be inf)
+    virtual void sample_direction(
+      const Eigen::Vector3d & q,
+      const double /*u*/,
+      const double /*v*/,
+      Eigen::Vector3d & d,
+      double & max_t) const
+    {
+      direction(q,d,max_t);
+    }
+    // Most shadow rays to spend per shading point (1 gives hard shadows)
+    virtual int max_shadow_samples() const { return 1; }
 };
 #endif
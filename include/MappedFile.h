@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The contents stay valid until
+// close() or destruction.
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+    // Map filename into memory (closing any previous mapping).
+    //
+    // Returns true on success, false if the file can't be opened or mapped
+    bool open(const std::string & filename);
+    void close();
+    // Pointer to the first byte (nullptr for empty or unmapped files)
+    const unsigned char * data() const { return bytes; }
+    size_t size() const { return num_bytes; }
+  private:
+    const unsigned char * bytes = nullptr;
+    size_t num_bytes = 0;
+#if defined(WIN32) || defined(_WIN32)
+    void * file_handle = nullptr;
+    void * mapping_handle = nullptr;
+#endif
+};
+
+#endif
@@ -2,7 +2,11 @@
 #define OBJECT_H
 
 #include "Material.h"
+#include "Beam.h"
+#include "BoundingBox.h"
+#include "Hit.h"
 #include <Eigen/Core>
+#include <limits>
 #include <memory>
 
 struct Ray;
@@ -12,19 +16,81 @@ class Object
     std::shared_ptr<Material> material;
     // https://stackoverflow.com/questions/461203/when-to-use-virtual-destructors
     virtual ~Object() {}
-    // Intersect object with ray.
+    // Find the first hit of a ray on the object, ignoring hits at or beyond
+    // max_t. Callers pass the closest hit found so far, so objects (and
+    // their BVH nodes) can give up on everything farther away. Only the
+    // distance and where on the object are found; the surface there is left
+    // to surface_normal, so it is computed once for the final hit.
     //
     // Inputs:
     //   Ray  ray to intersect with
     //   min_t  minimum parametric distance to consider
+    //   max_t  parametric distance at and beyond which hits are ignored
+    // Outputs:
+    //   hit  first hit in (min_t, max_t)
+    // Returns iff there a first intersection in (min_t, max_t) is found.
+    //
+    // The funny = 0 just ensures that this function is defined (as a no-op)
+    virtual bool closest_hit(
+        const Ray & ray,
+        const double min_t,
+        const double max_t,
+        Hit & hit) const = 0;
+    // Surface normal at a hit returned by closest_hit for the same ray.
+    //
+    // Inputs:
+    //   Ray  ray that was intersected
+    //   hit  its hit on this object
+    // Returns surface normal at ray.origin + hit.t * ray.direction
+    virtual Eigen::Vector3d surface_normal(
+        const Ray & ray, const Hit & hit) const = 0;
+    // Intersect object with ray (closest_hit followed by surface_normal).
+    //
+    // Inputs:
+    //   Ray  ray to intersect with
+    //   min_t  minimum parametric distance to consider
+    //   max_t  parametric distance at and beyond which hits are ignored
     // Outputs:
     //   t  first intersection at ray.origin + t * ray.direction
     //   n  surface normal at point of intersection
     // Returns iff there a first intersection is found.
-    //
-    // The funny = 0 just ensures that this function is defined (as a no-op)
-    virtual bool intersect(
-        const Ray & ray, const double min_t, double & t, Eigen::Vector3d & n) const = 0;
+    bool intersect(
+        const Ray & ray,
+        const double min_t,
+        const double max_t,
+        double & t,
+        Eigen::Vector3d & n) const
+    {
+      Hit hit;
+      if(!closest_hit(ray,min_t,max_t,hit))
+      {
+        return false;
+      }
+      t = hit.t;
+      n = surface_normal(ray,hit);
+      return true;
+    }
+    // Same without an upper bound
+    bool intersect(
+        const Ray & ray, const double min_t, double & t, Eigen::Vector3d & n) const
+    {
+      return intersect(
+        ray,min_t,std::numeric_limits<double>::infinity(),t,n);
+    }
+    // World-space bounds of the object, used to place it in a BVH. Objects
+    // without finite extent (the default) are tested against every ray.
+    virtual BoundingBox bounding_box() const { return BoundingBox::infinite(); }
+    // Whether some surface of the object might lie inside a beam (see
+    // Beam.h). False only if that is certain; the default tests the bounding
+    // box.
+    virtual bool intersects_beam(const Beam & beam) const
+    {
+      return !beam.outside(bounding_box());
+    }
+    // Whether every ray of the beam certainly hits this object in the
+    // footprint plane (the footprint lies inside one planar face). False when
+    // unsure, which the default always is.
+    virtual bool covers_beam(const Beam & /*beam*/) const { return false; }
 };
 
 #endif
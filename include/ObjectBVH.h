@@ -0,0 +1,152 @@
+#ifndef OBJECT_BVH_H
+#define OBJECT_BVH_H
+
+#include "BVH.h"
+#include "Object.h"
+#include "PlaneSet.h"
+#include "Ray.h"
+#include "SphereSet.h"
+#include <Eigen/Core>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Top level of the two-level BVH: a hierarchy over the world-space bounds of a
+// list of scene objects (typically Instances, which carry their own mesh BVH).
+// Spheres and planes skip the virtual Object::intersect: spheres get their
+// own batched hierarchy and planes a small list tested with every ray. Other
+// objects without finite bounds are kept aside and tested against every ray
+// too.
+class ObjectBVH
+{
+  public:
+    // Hierarchy over the other bounded objects (ids index the objects list)
+    BVH bvh;
+    // Every Sphere and Plane in the objects list. Scene edits never move
+    // these, so update() leaves them alone.
+    SphereSet spheres;
+    PlaneSet planes;
+    // Ids of other objects with infinite bounds
+    std::vector<int> unbounded;
+    // bvh.sah_cost() right after the last build
+    double built_cost = 0;
+    // Build over the current bounds of each object. Must be rebuilt if the
+    // list or any object's bounds change.
+    //
+    // Inputs:
+    //   objects  list of objects (shapes) in the scene
+    void build(const std::vector<std::shared_ptr<Object> > & objects);
+    // Bring the hierarchy up to date after objects moved (the list itself is
+    // unchanged). Refits in place and only rebuilds when the refitted tree's
+    // SAH cost has grown past rebuild_factor times its cost at build time, or
+    // when an object switched between bounded and unbounded.
+    //
+    // Inputs:
+    //   objects  the same list of objects this was built over
+    //   rebuild_factor  allowed cost growth before rebuilding
+    // Returns true iff the hierarchy was rebuilt rather than refitted
+    bool update(
+      const std::vector<std::shared_ptr<Object> > & objects,
+      const double rebuild_factor = 1.5);
+    // Same contract as first_hit over the objects list this was built from.
+    bool first_hit(
+      const Ray & ray,
+      const double min_t,
+      const std::vector<std::shared_ptr<Object> > & objects,
+      int & hit_id,
+      double & t,
+      Eigen::Vector3d & n,
+      const double max_t = std::numeric_limits<double>::infinity()) const;
+    // Whether any object might have surface inside the beam (see
+    // Object::intersects_beam)
+    bool intersects_beam(
+      const Beam & beam,
+      const std::vector<std::shared_ptr<Object> > & objects) const;
+};
+
+// Implementation
+
+inline bool ObjectBVH::first_hit(
+  const Ray & ray,
+  const double min_t,
+  const std::vector<std::shared_ptr<Object> > & objects,
+  int & hit_id,
+  double & t,
+  Eigen::Vector3d & n,
+  const double max_t) const
+{
+  // Planes, spheres and the hierarchy all search below the closest hit so
+  // far, so each one prunes the next. Only the closest hit's normal is
+  // computed, at the end.
+  enum Winner { none, plane, sphere, object };
+  Winner winner = none;
+  int p = -1, s = -1;
+  Hit closest;
+  closest.t = max_t;
+  if(planes.intersect(ray,min_t,closest.t,p))
+  {
+    winner = plane;
+  }
+  const auto test = [&](const int id, double & closest_t)->bool
+  {
+    Hit tmp_hit;
+    if(objects[id]->closest_hit(ray,min_t,closest_t,tmp_hit))
+    {
+      closest = tmp_hit;
+      closest_t = tmp_hit.t;
+      hit_id = id;
+      winner = object;
+      return true;
+    }
+    return false;
+  };
+  for(const int id : unbounded)
+  {
+    test(id,closest.t);
+  }
+  if(spheres.intersect(ray,min_t,closest.t,s))
+  {
+    winner = sphere;
+  }
+  bvh.intersect(ray,min_t,closest.t,test);
+  t = closest.t;
+  switch(winner)
+  {
+    case none:
+      return false;
+    case plane:
+      hit_id = planes.ids[p];
+      n = planes.normal(p);
+      break;
+    case sphere:
+      hit_id = spheres.ids[s];
+      n = spheres.normal(s,ray.origin+t*ray.direction);
+      break;
+    case object:
+      n = objects[hit_id]->surface_normal(ray,closest);
+      break;
+  }
+  return true;
+}
+
+inline bool ObjectBVH::intersects_beam(
+  const Beam & beam,
+  const std::vector<std::shared_ptr<Object> > & objects) const
+{
+  for(const int id : planes.ids)
+  {
+    if(objects[id]->intersects_beam(beam)) return true;
+  }
+  for(const int id : unbounded)
+  {
+    if(objects[id]->intersects_beam(beam)) return true;
+  }
+  const bool sphere_inside = spheres.bvh.any_of(
+    [&](const BoundingBox & box){ return !beam.outside(box); },
+    [&](const int s){ return objects[spheres.ids[s]]->intersects_beam(beam); });
+  return sphere_inside || bvh.any_of(
+    [&](const BoundingBox & box){ return !beam.outside(box); },
+    [&](const int id){ return objects[id]->intersects_beam(beam); });
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef ORBITAL_CAMERA_H
+#define ORBITAL_CAMERA_H
+
+#include "Camera.h"
+#include <Eigen/Core>
+#include <cmath>
+
+// Viewer camera described by a look-at target, the direction it is seen
+// from (yaw around +y, pitch above the horizon) and a distance.
+struct OrbitalCamera
+{
+  double yaw = 0.0;
+  double pitch = 0.05;
+  double distance = 2.2;
+  Eigen::Vector3d target = Eigen::Vector3d(0.0, 1.0, 0.0);
+  // Vertical field of view in radians
+  double vfov = 60.0 * M_PI / 180.0;
+};
+
+// Unit viewing direction for a yaw/pitch pair
+Eigen::Vector3d camera_forward(double yaw, double pitch);
+// Eye position of an orbital camera
+Eigen::Vector3d camera_eye(const OrbitalCamera & o);
+// Fill a ray-tracing camera from an orbital camera.
+//
+// Inputs:
+//   o  orbital camera
+//   aspect  image width divided by image height
+// Outputs:
+//   cam  camera with unit focal length looking at o.target
+void fill_camera(
+  const OrbitalCamera & o,
+  Camera & cam,
+  const double aspect = 16.0 / 9.0);
+
+#endif
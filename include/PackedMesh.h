@@ -0,0 +1,110 @@
+#ifndef PACKED_MESH_H
+#define PACKED_MESH_H
+
+#include "BVH.h"
+#include "Beam.h"
+#include "BoundingBox.h"
+#include "Hit.h"
+#include "Ray.h"
+#include "WideBVH.h"
+#include <Eigen/Core>
+#include <string>
+
+// How a mesh is shaded:
+//   flat  every triangle shows its own face normal
+//   per_vertex  normals averaged at shared vertices are interpolated across
+//     each triangle, smoothing over every edge
+//   per_corner  like per_vertex, but only faces bending less than an angle
+//     threshold are averaged, so sharp edges stay sharp
+enum class MeshNormals
+{
+  flat,
+  per_vertex,
+  per_corner
+};
+// Name of a shading mode ("flat", "per_vertex" or "per_corner")
+const char * mesh_normals_name(const MeshNormals normals);
+// Parse a shading mode name.
+//
+// Returns false (leaving normals untouched) for unknown names
+bool parse_mesh_normals(const std::string & name, MeshNormals & normals);
+
+// Triangle mesh geometry packed into flat row-major arrays together with a BVH
+// over its triangles. A PackedMesh is immutable once built and is meant to be
+// shared (via std::shared_ptr<const PackedMesh>) by any number of Instances.
+class PackedMesh
+{
+  public:
+    typedef Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> VertexMatrix;
+    typedef Eigen::Matrix<int, Eigen::Dynamic, 3, Eigen::RowMajor> FaceMatrix;
+    // #V by 3 list of vertex positions
+    VertexMatrix V;
+    // #F by 3 list of triangle indices into V
+    FaceMatrix F;
+    // How N is laid out and used
+    MeshNormals normals = MeshNormals::flat;
+    // Unit shading normals: empty (flat), #V by 3 (per_vertex) or #F*3 by 3
+    // (per_corner, corner c of triangle f at row 3*f+c)
+    VertexMatrix N;
+    // Hierarchy over the triangles in F (compressed, see WideBVH)
+    WideBVH bvh;
+    // (Re)build bvh from the current V and F.
+    //
+    // Inputs:
+    //   method  BVHBuild::linear for meshes whose topology changes often,
+    //     BVHBuild::sah for the fastest rendering
+    void build_bvh(const BVHBuild method = BVHBuild::sah);
+    // Refit bvh after vertices in V moved (F unchanged), e.g., for a
+    // deforming mesh. Rebuild instead if F changed.
+    void refit_bvh();
+    // (Re)compute N from the current V and F.
+    //
+    // Inputs:
+    //   kind  shading mode
+    //   corner_threshold  angle in degrees below which faces meeting at a
+    //     vertex are smoothed together (per_corner only)
+    void compute_normals(
+      const MeshNormals kind, const double corner_threshold = 20.0);
+    // Bounds of all triangles in object space
+    BoundingBox bounding_box() const { return bvh.bounding_box(); }
+    // Intersect the mesh with a ray given in object space.
+    //
+    // Inputs:
+    //   ray  ray to intersect with
+    //   min_t  minimum parametric distance to consider
+    //   max_t  parametric distance at and beyond which hits are ignored (BVH
+    //     nodes entered beyond it are skipped)
+    // Outputs:
+    //   hit  first intersection: t, the row of F hit and the barycentric
+    //     coordinates in it
+    // Returns iff there a first intersection is found.
+    bool closest_hit(
+      const Ray & ray,
+      const double min_t,
+      const double max_t,
+      Hit & hit) const;
+    // Unit surface normal at a hit from closest_hit, facing the ray: the
+    // face normal, or the interpolated shading normal (flipped along with
+    // the face normal).
+    Eigen::Vector3d surface_normal(const Ray & ray, const Hit & hit) const;
+    // Whether triangle f shades with its face normal everywhere, as the
+    // planar pre-pass (see coarse_visibility) assumes
+    bool flat_shaded(const int f) const;
+    // Beam queries in object space (see Object::intersects_beam and
+    // Object::covers_beam)
+    bool intersects_beam(const Beam & beam) const;
+    bool covers_beam(const Beam & beam) const;
+  private:
+    Eigen::Vector3d corner(const int f, const int c) const
+    {
+      return V.row(F(f,c)).cast<double>().transpose();
+    }
+    // Shading normal at corner c of triangle f (N must not be empty)
+    Eigen::Vector3d corner_normal(const int f, const int c) const
+    {
+      const int row = normals == MeshNormals::per_vertex ? F(f,c) : 3*f+c;
+      return N.row(row).cast<double>().transpose();
+    }
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef PIXEL_SAMPLER_H
+#define PIXEL_SAMPLER_H
+
+#include "hash_random.h"
+#include <cstdint>
+
+// Sampler pass of sample s (0 is the pixel's first ray) of frame seed; up to
+// 255 antialiasing samples per pixel
+inline uint32_t sample_pass(const uint32_t seed, const int s)
+{
+  return seed * 256u + static_cast<uint32_t>(s);
+}
+
+// Reproducible random numbers for the pixel sample being traced. The
+// renderer calls begin() before tracing each pixel sample and code further
+// down (e.g., soft shadows) draws numbers with next(). The sequence depends
+// only on the pixel and pass, never on which thread traces it, so repeated
+// frames match and accumulated passes converge. Soft shadows also report
+// here which area lights they found lit or blocked at the first hit, so that
+// the renderer can find penumbrae and trace them again with all_strata set.
+// Reflections differ too much between neighbouring pixels to tell a
+// penumbra, so they always take one sample per pass.
+struct PixelSampler
+{
+  uint32_t pixel = 0;
+  uint32_t pass = 0;
+  uint32_t index = 0;
+  // True while the first hit of the pixel sample is being shaded; shading
+  // clears it before following reflections
+  bool at_first_hit = true;
+  // Bit l%32 is set once light l's shadow sample at the first hit was lit
+  // (blocked)
+  uint32_t shadow_lit = 0;
+  uint32_t shadow_blocked = 0;
+  // Sample every stratum of an area light at the first hit rather than one
+  // per pass
+  bool all_strata = false;
+  // Start the sequence of a pixel sample, optionally skipping numbers that
+  // were already drawn from it
+  void begin(
+    const uint32_t pixel_, const uint32_t pass_, const uint32_t index_ = 0)
+  {
+    pixel = pixel_;
+    pass = pass_;
+    index = index_;
+    shadow_lit = 0;
+    shadow_blocked = 0;
+    at_first_hit = true;
+  }
+  // Next number in [0,1)
+  double next() { return hash_random(pixel,pass,index++); }
+  // Stratum (of n) to sample in this pass. Successive frame seeds and
+  // antialiasing samples step through all n in turn from a per-pixel
+  // offset, so neighbouring pixels see different strata and n accumulated
+  // passes cover each one once.
+  int stratum(const int n) const
+  {
+    const uint32_t offset = static_cast<uint32_t>(hash_random(pixel,~0u)*n);
+    return static_cast<int>((offset + pass / 256u + pass % 256u) % n);
+  }
+};
+
+// Sampler of the calling thread
+inline PixelSampler & this_thread_sampler()
+{
+  thread_local PixelSampler sampler;
+  return sampler;
+}
+
+#endif
@@ -2,9 +2,10 @@
 #define PLANE_H
 
 #include "Object.h"
+#include "Ray.h"
 #include <Eigen/Core>
 
-class Plane : public Object
+class Plane final : public Object
 {
   public:
     // Point on plane
@@ -16,12 +17,50 @@ class Plane : public Object
   // Inputs:
   //   Ray  ray to intersect with
   //   min_t  minimum parametric distance to consider
+  //   max_t  parametric distance at and beyond which hits are ignored
   // Outputs:
-  //   t  first intersection at ray.origin + t * ray.direction
-  //   n  surface normal at point of intersection
+  //   hit  first intersection (only t is set)
   // Returns iff there a first intersection is found.
-  bool intersect(
-    const Ray & ray, const double min_t, double & t, Eigen::Vector3d & n) const;
+  bool closest_hit(
+    const Ray & ray,
+    const double min_t,
+    const double max_t,
+    Hit & hit) const;
+  // The plane's normal
+  Eigen::Vector3d surface_normal(const Ray & ray, const Hit & hit) const;
+  // A plane covers any beam whose footprint lies in it, and otherwise only
+  // enters beams it passes between the apex and the footprint
+  bool intersects_beam(const Beam & beam) const;
+  bool covers_beam(const Beam & beam) const;
 };
 
+// Implementation (in the header so the intersection inlines into callers
+// that know the concrete type, with or without LTO; the beam queries are
+// in Plane.cpp)
+
+inline bool Plane::closest_hit(
+  const Ray & ray,
+  const double min_t,
+  const double max_t,
+  Hit & hit) const
+{
+  // (o + t d - p) . normal = 0
+  const double denom = normal.dot(ray.direction);
+  if (denom == 0) {
+    return false;
+  }
+  const double s = normal.dot(point - ray.origin) / denom;
+  if (s <= min_t || s >= max_t) {
+    return false;
+  }
+  hit.t = s;
+  return true;
+}
+
+inline Eigen::Vector3d Plane::surface_normal(
+  const Ray & /*ray*/, const Hit & /*hit*/) const
+{
+  return normal;
+}
+
 #endif
@@ -0,0 +1,114 @@
+#ifndef PLANE_SET_H
+#define PLANE_SET_H
+
+#include "Object.h"
+#include "Ray.h"
+#include <Eigen/Core>
+#include <limits>
+#include <memory>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define PLANE_SET_SSE
+#endif
+
+// The scene's infinite planes in structure-of-arrays form. There are only
+// ever a few, so every ray tests all of them, two at a time in SSE2
+// registers (one plane per double lane).
+class PlaneSet
+{
+  public:
+    // Plane normals (as given, not normalized) and offsets (n.x = offset),
+    // plus one padding entry so the last pair can always be loaded whole
+    std::vector<double> nx, ny, nz, offset;
+    // Object id of each plane
+    std::vector<int> ids;
+    // Gather the planes among objects.
+    //
+    // Inputs:
+    //   objects  list of objects in the scene
+    //   plane_ids  ids of the objects that are Planes
+    void build(
+      const std::vector<std::shared_ptr<Object> > & objects,
+      const std::vector<int> & plane_ids);
+    bool empty() const { return ids.empty(); }
+    // Find the closest plane hit in (min_t, max_t) (same contract as
+    // SphereSet::intersect)
+    bool intersect(
+      const Ray & ray,
+      const double min_t,
+      double & max_t,
+      int & hit) const;
+    // Normal of plane p, as Plane::intersect reports it
+    Eigen::Vector3d normal(const int p) const
+    {
+      return Eigen::Vector3d(nx[p],ny[p],nz[p]);
+    }
+};
+
+// Implementation
+
+inline bool PlaneSet::intersect(
+  const Ray & ray,
+  const double min_t,
+  double & max_t,
+  int & hit) const
+{
+  // (o + t d - point) . n = 0
+  const int count = static_cast<int>(ids.size());
+  double t[2];
+  bool found = false;
+#ifdef PLANE_SET_SSE
+  const __m128d dx = _mm_set1_pd(ray.direction.x());
+  const __m128d dy = _mm_set1_pd(ray.direction.y());
+  const __m128d dz = _mm_set1_pd(ray.direction.z());
+  const __m128d ox = _mm_set1_pd(ray.origin.x());
+  const __m128d oy = _mm_set1_pd(ray.origin.y());
+  const __m128d oz = _mm_set1_pd(ray.origin.z());
+  const __m128d min_t_v = _mm_set1_pd(min_t);
+  const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+  for(int p = 0;p<count;p+=2)
+  {
+    const __m128d px = _mm_loadu_pd(&nx[p]);
+    const __m128d py = _mm_loadu_pd(&ny[p]);
+    const __m128d pz = _mm_loadu_pd(&nz[p]);
+    const __m128d denom = _mm_add_pd(
+      _mm_add_pd(_mm_mul_pd(px,dx),_mm_mul_pd(py,dy)),_mm_mul_pd(pz,dz));
+    const __m128d t_v = _mm_div_pd(
+      _mm_sub_pd(_mm_loadu_pd(&offset[p]),_mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(px,ox),_mm_mul_pd(py,oy)),_mm_mul_pd(pz,oz))),
+      denom);
+    const __m128d valid = _mm_and_pd(
+      _mm_cmpneq_pd(denom,_mm_setzero_pd()),_mm_cmpgt_pd(t_v,min_t_v));
+    _mm_storeu_pd(t,
+      _mm_or_pd(_mm_and_pd(valid,t_v),_mm_andnot_pd(valid,inf)));
+    // The second lane is padding past the last plane
+    for(int k = 0;k<2 && p+k<count;k++)
+    {
+      if(t[k] < max_t)
+      {
+        max_t = t[k];
+        hit = p+k;
+        found = true;
+      }
+    }
+  }
+#else
+  for(int p = 0;p<count;p++)
+  {
+    const double denom =
+      nx[p]*ray.direction.x() + ny[p]*ray.direction.y() + nz[p]*ray.direction.z();
+    t[0] = (offset[p] -
+      (nx[p]*ray.origin.x() + ny[p]*ray.origin.y() + nz[p]*ray.origin.z()))/denom;
+    if(denom != 0 && t[0] > min_t && t[0] < max_t)
+    {
+      max_t = t[0];
+      hit = p;
+      found = true;
+    }
+  }
+#endif
+  return found;
+}
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef RAY_GENERATOR_H
+#define RAY_GENERATOR_H
+
+#include "Camera.h"
+#include "Ray.h"
+#include <Eigen/Core>
+#include <array>
+#include <cmath>
+
+// How rays leave the camera
+enum class CameraModel : int
+{
+  // Pinhole through the image plane (what viewing_ray does)
+  perspective = 0,
+  // Parallel rays from a rectangle around the eye
+  orthographic,
+  // Equidistant fisheye: the angle from the view axis grows linearly with
+  // the distance from the image centre
+  fisheye,
+  // Pinhole directions, but rays start anywhere on a disk-shaped aperture
+  // and converge at the focus distance (depth of field)
+  thin_lens,
+  count
+};
+
+// Human-readable name of a camera model
+const char * camera_model_name(const CameraModel model);
+
+// Camera model and its parameters
+struct Lens
+{
+  CameraModel model = CameraModel::perspective;
+  // Thin lens: radius of the aperture in world units
+  double aperture = 0.05;
+  // Distance along the view axis that is in focus (thin lens) and at which
+  // the orthographic view is as large as the perspective one. 0 uses the
+  // image plane distance.
+  double focus_distance = 0;
+  // Fisheye: field of view across the image height in radians
+  double fisheye_fov = M_PI;
+};
+
+// Structure-of-arrays batch of rays, laid out so that generating (and
+// later testing) several rays at once vectorizes
+struct RayPacket
+{
+  static const int size = 8;
+  alignas(64) std::array<double,size> ox, oy, oz;
+  alignas(64) std::array<double,size> dx, dy, dz;
+  // Copy ray k out of the packet
+  void get(const int k, Ray & ray) const
+  {
+    ray.origin = Eigen::Vector3d(ox[k],oy[k],oz[k]);
+    ray.direction = Eigen::Vector3d(dx[k],dy[k],dz[k]);
+  }
+};
+
+// Per-frame ray generator: the camera basis is combined with the pixel
+// spacing once per frame, so a ray through image position (x,y) is the
+// top-left direction plus x and y steps. The camera model is chosen once
+// here too, so generating a ray never branches on it.
+//
+// Like viewing_ray, rays reach the image plane (or its counterpart) at t=1.
+class RayGenerator
+{
+  public:
+    // Inputs:
+    //   camera  position, orientation and image plane of the camera
+    //   width  number of pixels width of image
+    //   height  number of pixels height of image
+    //   lens  camera model
+    RayGenerator(
+      const Camera & camera,
+      const int width,
+      const int height,
+      const Lens & lens = Lens());
+    // Generate a packet of rays.
+    //
+    // Inputs:
+    //   x  n horizontal image positions in pixels (j+0.5 is the centre of
+    //     column j)
+    //   y  n vertical image positions in pixels from the top
+    //   lens_samples  2*n numbers in [0,1) placing each ray on the aperture
+    //     (only read when uses_lens_samples())
+    //   n  number of rays, at most RayPacket::size
+    // Outputs:
+    //   packet  rays 0..n-1
+    void generate(
+      const double * x,
+      const double * y,
+      const double * lens_samples,
+      const int n,
+      RayPacket & packet) const
+    {
+      generate_fn(*this,x,y,lens_samples,n,packet);
+    }
+    // Single ray through image position (x,y) (see generate)
+    void ray(
+      const double x,
+      const double y,
+      const double lens_u,
+      const double lens_v,
+      Ray & ray) const;
+    // Whether rays depend on lens samples (a thin lens with an aperture;
+    // without one it is a pinhole)
+    bool uses_lens_samples() const
+    {
+      return lens.model == CameraModel::thin_lens;
+    }
+    // Whether all rays start at the eye (perspective), as the coarse
+    // visibility pass requires
+    bool pinhole() const { return lens.model == CameraModel::perspective; }
+    const Eigen::Vector3d & eye() const { return e; }
+    int width() const { return image_width; }
+    int height() const { return image_height; }
+  private:
+    template <CameraModel model> friend struct RayModel;
+    using GenerateFunction = void (*)(
+      const RayGenerator &, const double *, const double *, const double *,
+      const int, RayPacket &);
+    Lens lens;
+    int image_width;
+    int image_height;
+    Eigen::Vector3d e;
+    // Camera basis (u right, v up, w backward)
+    Eigen::Vector3d u, v, w;
+    // Direction through the top-left image corner and the steps between
+    // neighbouring pixels along a row and down a column
+    Eigen::Vector3d top_left;
+    Eigen::Vector3d du;
+    Eigen::Vector3d dv;
+    // Image plane distance
+    double d;
+    // Ratio of the focus distance to d
+    double focus_scale;
+    // Fisheye: angle per pixel from the image centre
+    double fisheye_scale;
+    GenerateFunction generate_fn;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef RECTLIGHT_H
+#define RECTLIGHT_H
+#include "Light.h"
+#include <Eigen/Core>
+// Parallelogram-shaped area light corner + u*edge_u + v*edge_v (u,v in
+// [0,1]) that casts soft shadows.
+class RectLight : public Light
+{
+  public:
+    Eigen::Vector3d corner, edge_u, edge_v;
+    // Most shadow rays per shading point (rounded up to a square)
+    int samples = 16;
+    // Direction toward the centre of the light.
+    //
+    // Input:
+    //   q  3D query point in space
+    // Outputs:
+    //    d  3D direction from point toward light as a vector.
+    //    max_t  parametric distance from q along d to light
+    void direction(
+      const Eigen::Vector3d & q, Eigen::Vector3d & d, double & max_t) const;
+    void sample_direction(
+      const Eigen::Vector3d & q,
+      const double u,
+      const double v,
+      Eigen::Vector3d & d,
+      double & max_t) const;
+    int max_shadow_samples() const { return samples; }
+};
+#endif
@@ -0,0 +1,92 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "Light.h"
+#include "Material.h"
+#include "Object.h"
+#include "ObjectBVH.h"
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <memory>
+#include <vector>
+
+// Consistent, immutable view of a scene for rendering. Nothing reachable from
+// a published snapshot is ever modified, so render threads may read it while
+// the next frame's edits are being made, without locks.
+struct SceneSnapshot
+{
+  std::vector<std::shared_ptr<Object> > objects;
+  std::vector<std::shared_ptr<Light> > lights;
+  // Top-level BVH over objects. Shared with later snapshots until objects
+  // are added or moved.
+  std::shared_ptr<const ObjectBVH> accel = std::make_shared<const ObjectBVH>();
+  // Increases by one with every commit
+  unsigned long long version = 0;
+};
+
+// Editable scene with versioned snapshots.
+//
+// Edits (moving instances, swapping materials, moving lights, ...) are staged
+// on the editing thread and become visible all at once when commit()
+// publishes a new snapshot. Edited objects and lights are copied rather than
+// modified in place, so snapshots handed out earlier stay valid for as long as
+// someone holds them. Moving objects refits a copy of the top-level BVH; it
+// is only rebuilt when objects are added or the refitted tree has degraded.
+// Commits that change neither (e.g., only lights or materials) share the
+// previous snapshot's BVH.
+//
+// Editing functions must be called from a single thread. snapshot() may be
+// called from any thread.
+class Scene
+{
+  public:
+    // Add an object/light. Returns its id (index into the snapshot lists).
+    int add_object(const std::shared_ptr<Object> & object);
+    int add_light(const std::shared_ptr<Light> & light);
+    // Set the object-to-world transform of an Instance. Other objects cannot
+    // be moved: spheres, planes and meshes carry their geometry in world
+    // space, and the BVH keeps spheres and planes in their own sets that
+    // are never refitted.
+    //
+    // Returns false if id is not an Instance
+    bool set_transform(const int id, const Eigen::Affine3d & transform);
+    // Replace the material of an object of any of the tracer's types.
+    //
+    // Returns false if id is out of range or of a type unknown to Scene
+    bool set_material(const int id, const std::shared_ptr<Material> & material);
+    // Move a PointLight or SphereLight.
+    //
+    // Returns false if id is neither
+    bool set_light_position(const int id, const Eigen::Vector3d & p);
+    // Change the color of a PointLight, SphereLight or RectLight.
+    //
+    // Returns false if id is none of those
+    bool set_light_intensity(const int id, const Eigen::Vector3d & I);
+    // Publish all staged edits as a new snapshot.
+    //
+    // Returns the published snapshot
+    std::shared_ptr<const SceneSnapshot> commit();
+    // Latest published snapshot (empty before the first commit)
+    std::shared_ptr<const SceneSnapshot> snapshot() const;
+  private:
+    // Return a private copy of object/light id that may be edited, copying
+    // at most once per commit.
+    template <typename T> std::shared_ptr<T> editable_object(const int id);
+    template <typename T> std::shared_ptr<T> editable_light(const int id);
+    // editable_object for whatever concrete type id has
+    std::shared_ptr<Object> editable_any_object(const int id);
+    std::vector<std::shared_ptr<Object> > objects;
+    std::vector<std::shared_ptr<Light> > lights;
+    // Objects/lights already copied since the last commit
+    std::vector<bool> object_copied, light_copied;
+    // BVH of the latest snapshot
+    std::shared_ptr<const ObjectBVH> accel =
+      std::make_shared<const ObjectBVH>();
+    bool objects_added = false;
+    bool objects_moved = false;
+    unsigned long long version = 0;
+    std::shared_ptr<const SceneSnapshot> published =
+      std::make_shared<const SceneSnapshot>();
+};
+
+#endif
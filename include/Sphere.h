@@ -1,11 +1,12 @@
 #ifndef SPHERE_H
 #define SPHERE_H
 
-#include "Sphere.h"
 #include "Object.h"
+#include "Ray.h"
 #include <Eigen/Core>
+#include <cmath>
 
-class Sphere : public Object
+class Sphere final : public Object
 {
   public:
     Eigen::Vector3d center;
@@ -16,12 +17,67 @@ class Sphere : public Object
     // Inputs:
     //   Ray  ray to intersect with
     //   min_t  minimum parametric distance to consider
+    //   max_t  parametric distance at and beyond which hits are ignored
     // Outputs:
-    //   t  first intersection at ray.origin + t * ray.direction
-    //   n  surface normal at point of intersection
+    //   hit  first intersection (only t is set)
     // Returns iff there a first intersection is found.
-    bool intersect(
-      const Ray & ray, const double min_t, double & t, Eigen::Vector3d & n) const;
+    bool closest_hit(
+      const Ray & ray,
+      const double min_t,
+      const double max_t,
+      Hit & hit) const;
+    // Outward unit normal at the hit
+    Eigen::Vector3d surface_normal(const Ray & ray, const Hit & hit) const;
+    // Axis-aligned box around the sphere
+    BoundingBox bounding_box() const;
 };
 
+// Implementation (in the header so the intersection inlines into callers
+// that know the concrete type, with or without LTO)
+
+inline bool Sphere::closest_hit(
+  const Ray & ray,
+  const double min_t,
+  const double max_t,
+  Hit & hit) const
+{
+  // |o + t d - c|^2 = r^2
+  const Eigen::Vector3d oc = ray.origin - center;
+  const double a = ray.direction.dot(ray.direction);
+  const double b = 2.0 * ray.direction.dot(oc);
+  const double c = oc.dot(oc) - radius * radius;
+  const double discriminant = b * b - 4.0 * a * c;
+  if (discriminant < 0) {
+    return false;
+  }
+  const double sqrt_disc = std::sqrt(discriminant);
+  const double t0 = (-b - sqrt_disc) / (2.0 * a);
+  const double t1 = (-b + sqrt_disc) / (2.0 * a);
+  double s;
+  if (t0 > min_t) {
+    s = t0;
+  } else if (t1 > min_t) {
+    s = t1;
+  } else {
+    return false;
+  }
+  if (s >= max_t) {
+    return false;
+  }
+  hit.t = s;
+  return true;
+}
+
+inline Eigen::Vector3d Sphere::surface_normal(
+  const Ray & ray, const Hit & hit) const
+{
+  return (ray.origin + hit.t * ray.direction - center) / radius;
+}
+
+inline BoundingBox Sphere::bounding_box() const
+{
+  const Eigen::Vector3d r = Eigen::Vector3d::Constant(radius);
+  return BoundingBox(center - r, center + r);
+}
+
 #endif
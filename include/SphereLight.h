@@ -0,0 +1,31 @@
+#ifndef SPHERELIGHT_H
+#define SPHERELIGHT_H
+#include "Light.h"
+#include <Eigen/Core>
+// Spherical area light that casts soft shadows. Seen from a shading point
+// the sphere is sampled as the disk through its centre facing that point.
+class SphereLight : public Light
+{
+  public:
+    Eigen::Vector3d p;
+    double radius = 0.1;
+    // Most shadow rays per shading point (rounded up to a square)
+    int samples = 16;
+    // Direction toward the centre of the light.
+    //
+    // Input:
+    //   q  3D query point in space
+    // Outputs:
+    //    d  3D direction from point toward light as a vector.
+    //    max_t  parametric distance from q along d to light
+    void direction(
+      const Eigen::Vector3d & q, Eigen::Vector3d & d, double & max_t) const;
+    void sample_direction(
+      const Eigen::Vector3d & q,
+      const double u,
+      const double v,
+      Eigen::Vector3d & d,
+      double & max_t) const;
+    int max_shadow_samples() const { return samples; }
+};
+#endif
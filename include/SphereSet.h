@@ -0,0 +1,157 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "BVH.h"
+#include "Object.h"
+#include "Ray.h"
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define SPHERE_SET_SSE
+#endif
+
+// The scene's spheres in structure-of-arrays form under their own BVH. Each
+// leaf owns a contiguous run of at most `lanes` spheres, which are tested
+// against a ray two at a time in SSE2 registers (one sphere per double lane)
+// instead of one virtual Sphere::intersect call each.
+class SphereSet
+{
+  public:
+    static const int lanes = 8;
+    // Hierarchy over the spheres; leaves index the arrays below directly
+    BVH bvh;
+    // Sphere centres and radii in leaf order, plus one padding entry so the
+    // last pair of a leaf can always be loaded whole
+    std::vector<double> cx, cy, cz, radius;
+    // Object id (index into the objects list) of each sphere
+    std::vector<int> ids;
+    // Gather the spheres among objects.
+    //
+    // Inputs:
+    //   objects  list of objects in the scene
+    //   sphere_ids  ids of the objects that are Spheres
+    void build(
+      const std::vector<std::shared_ptr<Object> > & objects,
+      const std::vector<int> & sphere_ids);
+    bool empty() const { return ids.empty(); }
+    size_t size() const { return ids.size(); }
+    // Find the closest sphere hit in (min_t, max_t).
+    //
+    // Inputs:
+    //   ray  ray to intersect with
+    //   min_t  minimum parametric distance to consider
+    //   max_t  current closest hit
+    // Outputs:
+    //   max_t  lowered to the hit, if any
+    //   hit  index of the sphere hit (into the arrays above)
+    // Returns true iff a sphere was hit closer than max_t
+    bool intersect(
+      const Ray & ray,
+      const double min_t,
+      double & max_t,
+      int & hit) const;
+    // Unit outward normal of sphere s at point p on it
+    Eigen::Vector3d normal(const int s, const Eigen::Vector3d & p) const
+    {
+      return (p - Eigen::Vector3d(cx[s],cy[s],cz[s]))/radius[s];
+    }
+};
+
+// Implementation
+
+inline bool SphereSet::intersect(
+  const Ray & ray,
+  const double min_t,
+  double & max_t,
+  int & hit) const
+{
+  const double a = ray.direction.squaredNorm();
+  const double inv_a = 1.0/a;
+  return bvh.intersect_leaves(ray,min_t,max_t,
+    [&](const int first, const int count, double & leaf_max_t)->bool
+    {
+      // |o + t d - c|^2 = r^2 with half of the usual b. Lanes past count
+      // hold the next leaf's spheres (or padding) and are never read.
+      double t[lanes+1];
+#ifdef SPHERE_SET_SSE
+      const __m128d dx = _mm_set1_pd(ray.direction.x());
+      const __m128d dy = _mm_set1_pd(ray.direction.y());
+      const __m128d dz = _mm_set1_pd(ray.direction.z());
+      const __m128d a_v = _mm_set1_pd(a);
+      const __m128d inv_a_v = _mm_set1_pd(inv_a);
+      const __m128d min_t_v = _mm_set1_pd(min_t);
+      const __m128d zero = _mm_setzero_pd();
+      const __m128d sign = _mm_set1_pd(-0.0);
+      const __m128d inf =
+        _mm_set1_pd(std::numeric_limits<double>::infinity());
+      for(int k = 0;k<count;k+=2)
+      {
+        const int s = first+k;
+        const __m128d ox =
+          _mm_sub_pd(_mm_set1_pd(ray.origin.x()),_mm_loadu_pd(&cx[s]));
+        const __m128d oy =
+          _mm_sub_pd(_mm_set1_pd(ray.origin.y()),_mm_loadu_pd(&cy[s]));
+        const __m128d oz =
+          _mm_sub_pd(_mm_set1_pd(ray.origin.z()),_mm_loadu_pd(&cz[s]));
+        const __m128d r = _mm_loadu_pd(&radius[s]);
+        const __m128d b = _mm_add_pd(
+          _mm_add_pd(_mm_mul_pd(dx,ox),_mm_mul_pd(dy,oy)),_mm_mul_pd(dz,oz));
+        const __m128d c = _mm_sub_pd(
+          _mm_add_pd(
+            _mm_add_pd(_mm_mul_pd(ox,ox),_mm_mul_pd(oy,oy)),
+            _mm_mul_pd(oz,oz)),
+          _mm_mul_pd(r,r));
+        const __m128d discriminant =
+          _mm_sub_pd(_mm_mul_pd(b,b),_mm_mul_pd(a_v,c));
+        // sqrtpd of the clamped discriminant: no branch, no errno
+        const __m128d root = _mm_sqrt_pd(_mm_max_pd(zero,discriminant));
+        const __m128d minus_b = _mm_xor_pd(b,sign);
+        const __m128d t0 = _mm_mul_pd(_mm_sub_pd(minus_b,root),inv_a_v);
+        const __m128d t1 = _mm_mul_pd(_mm_add_pd(minus_b,root),inv_a_v);
+        const __m128d use_t0 = _mm_cmpgt_pd(t0,min_t_v);
+        const __m128d first_t = _mm_or_pd(
+          _mm_and_pd(use_t0,t0),_mm_andnot_pd(use_t0,t1));
+        const __m128d valid = _mm_and_pd(
+          _mm_cmpge_pd(discriminant,zero),_mm_cmpgt_pd(first_t,min_t_v));
+        _mm_storeu_pd(&t[k],
+          _mm_or_pd(_mm_and_pd(valid,first_t),_mm_andnot_pd(valid,inf)));
+      }
+#else
+      for(int k = 0;k<count;k++)
+      {
+        const int s = first+k;
+        const double ox = ray.origin.x()-cx[s];
+        const double oy = ray.origin.y()-cy[s];
+        const double oz = ray.origin.z()-cz[s];
+        const double b =
+          ray.direction.x()*ox + ray.direction.y()*oy + ray.direction.z()*oz;
+        const double c = ox*ox + oy*oy + oz*oz - radius[s]*radius[s];
+        const double discriminant = b*b - a*c;
+        const double root = std::sqrt(std::max(discriminant,0.0));
+        const double t0 = (-b-root)*inv_a;
+        const double t1 = (-b+root)*inv_a;
+        const double first_t = t0 > min_t ? t0 : t1;
+        t[k] = discriminant >= 0 && first_t > min_t ?
+          first_t : std::numeric_limits<double>::infinity();
+      }
+#endif
+      bool found = false;
+      for(int k = 0;k<count;k++)
+      {
+        if(t[k] < leaf_max_t)
+        {
+          leaf_max_t = t[k];
+          hit = first+k;
+          found = true;
+        }
+      }
+      return found;
+    });
+}
+
+#endif
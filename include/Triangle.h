@@ -13,12 +13,18 @@ public:
   // Inputs:
   //   Ray  ray to intersect with
   //   min_t  minimum parametric distance to consider
+  //   max_t  parametric distance at and beyond which hits are ignored
   // Outputs:
-  //   t  first intersection at ray.origin + t * ray.direction
-  //   n  surface normal at point of intersection
+  //   hit  first intersection with its barycentric coordinates
   // Returns iff there a first intersection is found.
-  bool intersect(const Ray &ray, const double min_t, double &t,
-                 Eigen::Vector3d &n) const;
+  bool closest_hit(const Ray &ray, const double min_t, const double max_t,
+                   Hit &hit) const;
+  // Unit face normal, facing the ray
+  Eigen::Vector3d surface_normal(const Ray &ray, const Hit &hit) const;
+  // Bounds of the three corners
+  BoundingBox bounding_box() const;
+  bool intersects_beam(const Beam &beam) const;
+  bool covers_beam(const Beam &beam) const;
 };
 
 #endif
@@ -13,17 +13,22 @@ public:
   // A soup is just a set (list) of triangles
   std::vector<std::shared_ptr<Object>> triangles;
 
-  // Intersect a triangle soup with ray.
+  // Intersect a triangle soup with ray. Each triangle is tested against the
+  // closest hit so far.
   //
   // Inputs:
   //   Ray  ray to intersect with
   //   min_t  minimum parametric distance to consider
+  //   max_t  parametric distance at and beyond which hits are ignored
   // Outputs:
-  //   t  first intersection at ray.origin + t * ray.direction
-  //   n  surface normal at point of intersection
+  //   hit  first intersection; primitive is the index into triangles
   // Returns iff there a first intersection is found.
-  bool intersect(const Ray &ray, const double min_t, double &t,
-                 Eigen::Vector3d &n) const;
+  bool closest_hit(const Ray &ray, const double min_t, const double max_t,
+                   Hit &hit) const;
+  // Normal of the triangle that was hit
+  Eigen::Vector3d surface_normal(const Ray &ray, const Hit &hit) const;
+  // Union of the bounds of all triangles
+  BoundingBox bounding_box() const;
 };
 
 #endif
@@ -0,0 +1,343 @@
+#ifndef WIDE_BVH_H
+#define WIDE_BVH_H
+
+#include "BVH.h"
+#include "BoundingBox.h"
+#include "Ray.h"
+#include "ray_stats.h"
+#include <Eigen/Core>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define WIDE_BVH_SSE
+#endif
+
+// 2^e for exponents in the normal float range, without a libm call
+inline float exp2_int(const int e)
+{
+  const uint32_t bits = static_cast<uint32_t>(e+127) << 23;
+  float x;
+  std::memcpy(&x,&bits,sizeof(x));
+  return x;
+}
+
+// Node of a compressed 4-wide BVH, one 64-byte cache line. Child boxes are
+// stored as 8-bit offsets on a per-axis grid spanning the node: child k
+// covers origin + [lo,hi]*2^exponent along each axis, rounded outwards so the
+// decoded boxes always contain the real ones. Leaves are not nodes of their
+// own; a leaf child is a range of primitives.
+struct alignas(64) WideBVHNode
+{
+  static const int width = 4;
+  float origin[3];
+  int8_t exponent[3];
+  // Per child: 0 for an interior child, else the number of primitives in a
+  // leaf child
+  uint8_t count[width];
+  uint8_t unused;
+  // Quantized child bounds, axis-major so one axis of all children is
+  // contiguous
+  uint8_t lo[3][width];
+  uint8_t hi[3][width];
+  // Per child: index of the child node (interior), offset of the first
+  // primitive in indices (leaf), or -1 for an empty slot
+  int32_t child[width];
+  int32_t padding;
+  // Decoded (conservative) bounds of child k
+  BoundingBox child_box(const int k) const
+  {
+    BoundingBox box;
+    for(int a = 0;a<3;a++)
+    {
+      const float scale = exp2_int(exponent[a]);
+      box.min_corner(a) = origin[a] + lo[a][k]*scale;
+      box.max_corner(a) = origin[a] + hi[a][k]*scale;
+    }
+    return box;
+  }
+};
+static_assert(sizeof(WideBVHNode) == 64,"WideBVHNode must fill one cache line");
+
+// Slab test of a ray against all four (quantized) child boxes of a node, in
+// single precision, clipped to [min_t,max_t]. NaNs (0*inf) leave a child's
+// interval untouched, as in ray_intersect_box. The SSE and scalar versions
+// give identical results.
+//
+// Inputs:
+//   node  node whose children to test
+//   origin  ray origin
+//   inv  componentwise inverse of the ray direction
+//   far_scale  factor (slightly above 1) applied to each exit distance
+//   min_t,max_t  interval to clip to
+// Outputs:
+//   t0  entry distance of each child
+// Returns bit k set iff child k's box is hit
+inline int intersect_child_boxes(
+  const WideBVHNode & node,
+  const float origin[3],
+  const float inv[3],
+  const float far_scale,
+  const float min_t,
+  const float max_t,
+  float t0[WideBVHNode::width])
+{
+#ifdef WIDE_BVH_SSE
+  static_assert(WideBVHNode::width == 4,"one child per SSE lane");
+  // The four 8-bit offsets of one axis as four floats
+  const auto widen = [](const uint8_t * q)
+  {
+    int32_t bits;
+    std::memcpy(&bits,q,sizeof(bits));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bytes = _mm_cvtsi32_si128(bits);
+    return _mm_cvtepi32_ps(
+      _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes,zero),zero));
+  };
+  __m128 near_t = _mm_set1_ps(min_t);
+  __m128 far_t = _mm_set1_ps(max_t);
+  for(int a = 0;a<3;a++)
+  {
+    const __m128 scale = _mm_set1_ps(exp2_int(node.exponent[a]));
+    const __m128 base = _mm_set1_ps(node.origin[a]-origin[a]);
+    const __m128 inv_a = _mm_set1_ps(inv[a]);
+    const __m128 ta = _mm_mul_ps(
+      _mm_add_ps(base,_mm_mul_ps(widen(node.lo[a]),scale)),inv_a);
+    const __m128 tb = _mm_mul_ps(
+      _mm_add_ps(base,_mm_mul_ps(widen(node.hi[a]),scale)),inv_a);
+    // minps/maxps return their second operand unless the comparison holds,
+    // so the operand order fixes which of a NaN pair survives
+    near_t = _mm_max_ps(_mm_min_ps(ta,tb),near_t);
+    far_t = _mm_min_ps(
+      _mm_mul_ps(_mm_max_ps(tb,ta),_mm_set1_ps(far_scale)),far_t);
+  }
+  _mm_storeu_ps(t0,near_t);
+  return _mm_movemask_ps(_mm_cmple_ps(near_t,far_t));
+#else
+  const int width = WideBVHNode::width;
+  float t1[width];
+  for(int k = 0;k<width;k++)
+  {
+    t0[k] = min_t;
+    t1[k] = max_t;
+  }
+  for(int a = 0;a<3;a++)
+  {
+    const float scale = exp2_int(node.exponent[a]);
+    const float base = node.origin[a]-origin[a];
+    for(int k = 0;k<width;k++)
+    {
+      const float ta = (base + node.lo[a][k]*scale)*inv[a];
+      const float tb = (base + node.hi[a][k]*scale)*inv[a];
+      const float near = ta < tb ? ta : tb;
+      const float far = ta < tb ? tb : ta;
+      t0[k] = near > t0[k] ? near : t0[k];
+      t1[k] = far*far_scale < t1[k] ? far*far_scale : t1[k];
+    }
+  }
+  int mask = 0;
+  for(int k = 0;k<width;k++)
+  {
+    mask |= (t0[k] <= t1[k]) << k;
+  }
+  return mask;
+#endif
+}
+
+// Compressed 4-wide bounding volume hierarchy, built by collapsing a binary
+// BVH. Each visited node tests all four children at once over their
+// quantized boxes (intersect_child_boxes: one SSE lane per child), so
+// traversal touches about a fifth of the memory of the binary tree. Same
+// queries as BVH.
+class WideBVH
+{
+  public:
+    std::vector<WideBVHNode> nodes;
+    // Primitive ids ordered so that each leaf owns a contiguous range
+    std::vector<int> indices;
+    // Build a binary BVH (see BVH::build) and collapse it.
+    //
+    // Inputs:
+    //   boxes  #primitives list of (finite) primitive bounding boxes
+    //   leaf_size  maximum number of primitives per leaf (at most 255)
+    //   method  how to choose splits
+    void build(
+      const std::vector<BoundingBox> & boxes,
+      const int leaf_size = 4,
+      const BVHBuild method = BVHBuild::sah);
+    // Recompute (and requantize) all bounds for moved primitives, keeping
+    // the tree topology.
+    //
+    // Inputs:
+    //   boxes  list of primitive bounding boxes indexed by primitive id
+    void refit(const std::vector<BoundingBox> & boxes);
+    bool empty() const { return nodes.empty(); }
+    // Whether the tree is safe to traverse: interior children point forward
+    // into nodes, leaf ranges lie inside indices, every index is below
+    // num_primitives and the tree fits the traversal stacks. Trees from
+    // build always are; this is for trees read back from storage.
+    //
+    // Inputs:
+    //   num_primitives  number of primitives the indices refer to
+    bool valid(const int num_primitives) const;
+    // Exact bounds of everything in the hierarchy
+    BoundingBox bounding_box() const { return root_box; }
+    // Set by refit; stored separately so that a cached tree can restore it
+    BoundingBox root_box;
+    // Same contracts as BVH::intersect, BVH::intersect_leaves and
+    // BVH::any_of
+    template <typename PrimitiveIntersector>
+    bool intersect(
+      const Ray & ray,
+      const double min_t,
+      double & max_t,
+      PrimitiveIntersector && intersect_primitive) const;
+    template <typename LeafIntersector>
+    bool intersect_leaves(
+      const Ray & ray,
+      const double min_t,
+      double & max_t,
+      LeafIntersector && intersect_leaf) const;
+    template <typename BoxTest, typename Visitor>
+    bool any_of(BoxTest && overlaps, Visitor && accept) const;
+  private:
+    // Quantize the child boxes of node i
+    void quantize(const int i, const BoundingBox * child_boxes);
+};
+
+// Implementation
+
+template <typename PrimitiveIntersector>
+inline bool WideBVH::intersect(
+  const Ray & ray,
+  const double min_t,
+  double & max_t,
+  PrimitiveIntersector && intersect_primitive) const
+{
+  return intersect_leaves(ray,min_t,max_t,
+    [&](const int first, const int count, double & leaf_max_t)->bool
+    {
+      bool hit = false;
+      for(int i = first;i<first+count;i++)
+      {
+        hit |= intersect_primitive(indices[i],leaf_max_t);
+      }
+      return hit;
+    });
+}
+
+template <typename LeafIntersector>
+inline bool WideBVH::intersect_leaves(
+  const Ray & ray,
+  const double min_t,
+  double & max_t,
+  LeafIntersector && intersect_leaf) const
+{
+  const int width = WideBVHNode::width;
+  if(nodes.empty()) return false;
+  const Eigen::Vector3d inv_direction = ray.direction.cwiseInverse();
+  double t_enter;
+  if(!ray_intersect_box(ray.origin,inv_direction,root_box,min_t,max_t,t_enter))
+  {
+    return false;
+  }
+  const float origin[3] = {
+    static_cast<float>(ray.origin.x()),
+    static_cast<float>(ray.origin.y()),
+    static_cast<float>(ray.origin.z())};
+  const float inv[3] = {
+    static_cast<float>(inv_direction.x()),
+    static_cast<float>(inv_direction.y()),
+    static_cast<float>(inv_direction.z())};
+  // Single precision slabs may shave a few ulps off the exit distance
+  const float far_scale = 1.0f + 4.0f*std::numeric_limits<float>::epsilon();
+  bool hit = false;
+  uint64_t visits = 0;
+  uint64_t early_outs = 0;
+  // An entry is a node (count 0) or a leaf range (count > 0). Each node
+  // pushes at most width-1 entries more than it pops.
+  struct Entry { int index; int count; double t_enter; };
+  Entry stack[64*(width-1)+1];
+  int top = 0;
+  stack[top++] = {0,0,t_enter};
+  while(top > 0)
+  {
+    const Entry entry = stack[--top];
+    if(entry.t_enter > max_t)
+    {
+      early_outs++;
+      continue;
+    }
+    if(entry.count > 0)
+    {
+      hit |= intersect_leaf(entry.index,entry.count,max_t);
+      continue;
+    }
+    visits++;
+    const WideBVHNode & node = nodes[entry.index];
+    float t0[width];
+    const int hit_mask = intersect_child_boxes(
+      node,origin,inv,far_scale,
+      static_cast<float>(min_t),static_cast<float>(max_t),t0);
+    // Push hit children far to near so the nearest is popped first
+    int order[width];
+    int num_hit = 0;
+    for(int k = 0;k<width;k++)
+    {
+      if(node.child[k] >= 0 && (hit_mask & (1 << k)))
+      {
+        int j = num_hit++;
+        while(j > 0 && t0[order[j-1]] < t0[k])
+        {
+          order[j] = order[j-1];
+          j--;
+        }
+        order[j] = k;
+      }
+    }
+    for(int j = 0;j<num_hit;j++)
+    {
+      const int k = order[j];
+      stack[top++] = {node.child[k],node.count[k],t0[k]};
+    }
+  }
+  count_ray_stat(RayCounter::bvh_node_visits,visits);
+  count_ray_stat(RayCounter::early_outs,early_outs);
+  return hit;
+}
+
+template <typename BoxTest, typename Visitor>
+inline bool WideBVH::any_of(BoxTest && overlaps, Visitor && accept) const
+{
+  const int width = WideBVHNode::width;
+  if(nodes.empty() || !overlaps(root_box)) return false;
+  int stack[64*(width-1)+1];
+  int top = 0;
+  stack[top++] = 0;
+  while(top > 0)
+  {
+    const WideBVHNode & node = nodes[stack[--top]];
+    for(int k = 0;k<width;k++)
+    {
+      if(node.child[k] < 0 || !overlaps(node.child_box(k)))
+      {
+        continue;
+      }
+      if(node.count[k] == 0)
+      {
+        stack[top++] = node.child[k];
+        continue;
+      }
+      for(int i = node.child[k];i<node.child[k]+node.count[k];i++)
+      {
+        if(accept(indices[i])) return true;
+      }
+    }
+  }
+  return false;
+}
+
+#endif
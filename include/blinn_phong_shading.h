@@ -7,6 +7,7 @@
 #include <vector>
 #include <memory>
 
+class ObjectBVH;
 
 // Given a ray and its hit in the scene, return the Blinn-Phong shading
 // contribution over all _visible_ light sources (e.g., take into account
@@ -19,6 +20,8 @@
 //   n  unit surface normal at hit
 //   objects  list of objects in the scene
 //   lights  list of lights in the scene
+//   accel  optional top-level BVH built over objects (nullptr to test every
+//     object)
 // Returns shaded color collected by this ray as rgb 3-vector
 Eigen::Vector3d blinn_phong_shading(
   const Ray & ray,
@@ -26,6 +29,7 @@ Eigen::Vector3d blinn_phong_shading(
   const double & t,
   const Eigen::Vector3d & n,
   const std::vector< std::shared_ptr<Object> > & objects,
-  const std::vector<std::shared_ptr<Light> > & lights);
+  const std::vector<std::shared_ptr<Light> > & lights,
+  const ObjectBVH * accel = nullptr);
 
 #endif
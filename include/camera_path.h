@@ -0,0 +1,44 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include "OrbitalCamera.h"
+#include <string>
+#include <vector>
+
+// Read a camera path from a .json file. The file is either a list of
+// cameras (one frame each):
+//
+//   [ {"yaw": 0.0, "pitch": 0.1, "distance": 2.0, "target": [0,1,0]}, ... ]
+//
+// or keyframes that are interpolated linearly over a number of frames:
+//
+//   { "frames": 120,
+//     "keyframes": [ {"frame": 0, "yaw": 0.0}, {"frame": 119, "yaw": 6.28} ] }
+//
+// Angles are in radians ("vfov_degrees" sets the field of view). Fields a
+// camera or keyframe leaves out keep the value of start.
+//
+// Inputs:
+//   filename  path to .json file
+//   start  camera supplying defaults for missing fields
+// Outputs:
+//   path  one camera per frame
+// Returns true on success, false if the file can't be read or parsed
+bool read_camera_path(
+  const std::string & filename,
+  const OrbitalCamera & start,
+  std::vector<OrbitalCamera> & path);
+
+// Full turn of the camera around its target.
+//
+// Inputs:
+//   start  first camera of the turn
+//   frames  number of frames (the last frame stops one step short of start)
+// Outputs:
+//   path  frames cameras with yaw advancing by 2*pi/frames each frame
+void turntable_path(
+  const OrbitalCamera & start,
+  const int frames,
+  std::vector<OrbitalCamera> & path);
+
+#endif
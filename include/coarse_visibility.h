@@ -0,0 +1,72 @@
+#ifndef COARSE_VISIBILITY_H
+#define COARSE_VISIBILITY_H
+
+#include "Ray.h"
+#include "RayGenerator.h"
+#include "Scene.h"
+#include <Eigen/Core>
+#include <memory>
+#include <vector>
+
+// Result of the coarse visibility pre-pass: which blocks of pixels are known
+// to see nothing but one plane of one object (a wall, the floor, ...). Rays
+// of those blocks meet the plane analytically instead of traversing the BVH.
+struct CoarseVisibility
+{
+  // Block size in pixels (0 when the pass was skipped)
+  int block = 0;
+  int blocks_x = 0;
+  int blocks_y = 0;
+  // Per block (row-major): object seen by the whole block, -1 if the block
+  // must be traced normally
+  std::vector<int> hit_id;
+  // Per planar block: plane as (n, offset) with n.x = offset, n being the
+  // normal first_hit reports there
+  std::vector<Eigen::Vector4d> plane;
+  // Number of pixels in planar blocks
+  int planar_pixels = 0;
+  // Index of the planar block containing pixel (i,j), -1 if not planar
+  int planar_block(const int i, const int j) const
+  {
+    if(block <= 0)
+    {
+      return -1;
+    }
+    const int b = (j/block) + blocks_x*(i/block);
+    return hit_id[b] >= 0 ? b : -1;
+  }
+  // Hit of a primary ray of planar block b (same contract as first_hit)
+  void first_hit(
+    const int b,
+    const Ray & ray,
+    int & id,
+    double & t,
+    Eigen::Vector3d & n) const
+  {
+    n = plane[b].head<3>();
+    t = (plane[b](3) - n.dot(ray.origin))/n.dot(ray.direction);
+    id = hit_id[b];
+  }
+};
+
+// Trace one ray through each corner of every block x block tile of the image
+// and mark the tiles whose corners all hit the same plane of the same object.
+// A tile only counts as planar if the object certainly covers the tile's
+// footprint on the plane and no surface of any object pokes into the pyramid
+// between the eye and that footprint; tiles on silhouettes, creases and
+// anything small enough to slip between the corner rays fall back to normal
+// tracing.
+//
+// Inputs:
+//   scene  scene to look at
+//   generator  rays of the frame (must be a pinhole camera)
+//   block  tile size in pixels (0 disables the pass)
+// Outputs:
+//   vis  planar tiles
+void coarse_visibility(
+  const SceneSnapshot & scene,
+  const RayGenerator & generator,
+  const int block,
+  CoarseVisibility & vis);
+
+#endif
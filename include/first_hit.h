@@ -4,9 +4,12 @@
 #include "Ray.h"
 #include "Object.h"
 #include <Eigen/Core>
+#include <limits>
 #include <vector>
 #include <memory>
 
+class ObjectBVH;
+
 // Find the first (visible) hit given a ray and a collection of scene objects
 //
 // Inputs:
@@ -14,6 +17,11 @@
 //   min_t  minimum t value to consider (for viewing rays, this is typically at
 //     least the _parametric_ distance of the image plane to the camera)
 //   objects  list of objects (shapes) in the scene
+//   accel  optional top-level BVH built over objects (nullptr to test every
+//     object)
+//   max_t  hits at or beyond this are ignored (e.g., the distance to a light
+//     for shadow rays); each object is also only searched up to the closest
+//     hit found so far
 // Outputs:
 //   hit_id  index into objects of object with first hit
 //   t  _parametric_ distance along ray so that ray.origin+t*ray.direction is
@@ -26,6 +34,8 @@ bool first_hit(
   const std::vector< std::shared_ptr<Object> > & objects,
   int & hit_id, 
   double & t,
-  Eigen::Vector3d & n);
+  Eigen::Vector3d & n,
+  const ObjectBVH * accel = nullptr,
+  const double max_t = std::numeric_limits<double>::infinity());
 
 #endif
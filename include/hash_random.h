@@ -0,0 +1,25 @@
+#ifndef HASH_RANDOM_H
+#define HASH_RANDOM_H
+
+#include <cstdint>
+
+// Reproducible pseudo-random number in [0,1) for a tuple of integers (e.g.,
+// pixel, sample, dimension). The same tuple always gives the same number,
+// independent of thread scheduling, so images can be compared bit for bit.
+inline double hash_random(
+  const uint32_t a,
+  const uint32_t b,
+  const uint32_t c = 0)
+{
+  // lowbias32 (Chris Wellons) over a mix of the inputs
+  uint32_t h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u) * 0x85EBCA77u ^
+               (c + 0x165667B1u) * 0xC2B2AE3Du;
+  h ^= h >> 16;
+  h *= 0x7FEB352Du;
+  h ^= h >> 15;
+  h *= 0x846CA68Bu;
+  h ^= h >> 16;
+  return h * (1.0 / 4294967296.0);
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef PACK_MESH_H
+#define PACK_MESH_H
+
+#include "PackedMesh.h"
+#include <Eigen/Core>
+#include <memory>
+
+// Pack a triangle or quad mesh into a shareable PackedMesh (quads are split
+// along their first diagonal) and build its BVH and shading normals.
+//
+// Inputs:
+//   V  #V by 3 list of vertex positions
+//   F  #F by poly=(3 or 4) list of mesh face indices into V
+//   method  how to build the BVH (see BVHBuild)
+//   normals  how to shade the mesh (see MeshNormals)
+// Returns packed mesh with #F or 2*#F triangles
+std::shared_ptr<PackedMesh> pack_mesh(
+  const Eigen::MatrixXd & V,
+  const Eigen::MatrixXi & F,
+  const BVHBuild method = BVHBuild::sah,
+  const MeshNormals normals = MeshNormals::flat);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Pipeline stages timed by the frame profiler
+enum class ProfileStage : int
+{
+  camera_setup = 0,
+  // pre-pass finding blocks that only see one plane
+  coarse_visibility,
+  // one row of the image (only used to lay out the trace per thread)
+  rows,
+  primary_rays,
+  first_hit,
+  shading,
+  shadow_rays,
+  reflection,
+  pixel_packing,
+  texture_upload,
+  present,
+  count
+};
+const int num_profile_stages = static_cast<int>(ProfileStage::count);
+
+// Human-readable name of a stage
+const char * profile_stage_name(const ProfileStage stage);
+
+// Stage times gathered since the previous profile_collect(), summed over all
+// threads.
+struct FrameProfile
+{
+  // Time spent in each stage excluding nested stages
+  std::array<double,num_profile_stages> self_ms{};
+  // Time spent in each stage including nested stages (recursive entries of
+  // the same stage are only counted once)
+  std::array<double,num_profile_stages> total_ms{};
+  std::array<uint64_t,num_profile_stages> calls{};
+  // Wall-clock time covered by this profile
+  double wall_ms = 0;
+};
+
+// Whether the scoped timers were compiled in (cmake -DRT_PROFILE=ON or a
+// Debug build)
+#ifdef RT_PROFILE
+const bool profiler_compiled = true;
+#else
+const bool profiler_compiled = false;
+#endif
+
+// Gather every thread's timers into a profile and start a new interval. When
+// tracing, the profile is also recorded as counter events.
+FrameProfile profile_collect();
+// Start recording a Chrome trace (chrome://tracing, ui.perfetto.dev).
+//
+// Inputs:
+//   filename  path of the .json file written by profile_stop_trace()
+void profile_start_trace(const std::string & filename);
+// Write the trace started by profile_start_trace().
+//
+// Returns true on success, false if the file can't be written or no trace
+// was started
+bool profile_stop_trace();
+
+// Times the enclosing scope for one stage. Use through RT_PROFILE_SCOPE so
+// release builds compile it out.
+class ProfileScope
+{
+  public:
+    explicit ProfileScope(const ProfileStage stage);
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope & operator=(const ProfileScope &) = delete;
+    ~ProfileScope();
+  private:
+    ProfileStage stage;
+    std::chrono::steady_clock::time_point start;
+    // Time spent in scopes nested inside this one
+    std::chrono::steady_clock::duration nested{0};
+    ProfileScope * parent;
+};
+
+#ifdef RT_PROFILE
+#  define RT_PROFILE_CONCAT_(a,b) a##b
+#  define RT_PROFILE_CONCAT(a,b) RT_PROFILE_CONCAT_(a,b)
+#  define RT_PROFILE_SCOPE(stage) \
+     ProfileScope RT_PROFILE_CONCAT(profile_scope_,__LINE__)(ProfileStage::stage)
+#else
+#  define RT_PROFILE_SCOPE(stage) ((void)0)
+#endif
+
+#endif
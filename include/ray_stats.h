@@ -0,0 +1,70 @@
+#ifndef RAY_STATS_H
+#define RAY_STATS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Work counted while tracing
+enum class RayCounter : int
+{
+  primary_rays = 0,
+  shadow_rays,
+  reflection_rays,
+  triangle_tests,
+  bvh_node_visits,
+  // BVH nodes skipped because a closer hit was found after they were queued
+  early_outs,
+  count
+};
+const int num_ray_counters = static_cast<int>(RayCounter::count);
+
+// Human-readable name of a counter (also used as csv column header)
+const char * ray_counter_name(const RayCounter counter);
+
+// Counts gathered over an interval, summed over all threads
+struct RayStats
+{
+  std::array<uint64_t,num_ray_counters> counts{};
+  // Length of the interval
+  double seconds = 0;
+  uint64_t operator[](const RayCounter c) const
+  {
+    return counts[static_cast<int>(c)];
+  }
+  // Primary, shadow and reflection rays
+  uint64_t rays() const;
+  double rays_per_second() const;
+  // Triangle tests per ray
+  double tests_per_ray() const;
+  // Add another interval's counts and time
+  RayStats & operator+=(const RayStats & other);
+};
+
+// Counters of one thread, written only by that thread. Padded to a cache
+// line so threads never contend on each other's counters.
+struct alignas(64) ThreadRayCounters
+{
+  ThreadRayCounters();
+  std::array<std::atomic<uint64_t>,num_ray_counters> counts;
+};
+
+// Counters of the calling thread (registered on first use)
+ThreadRayCounters & this_thread_ray_counters();
+
+// Add n to one of the calling thread's counters. Hot loops should count
+// locally and call this once.
+inline void count_ray_stat(const RayCounter counter, const uint64_t n = 1)
+{
+  thread_local ThreadRayCounters & counters = this_thread_ray_counters();
+  std::atomic<uint64_t> & x = counters.counts[static_cast<int>(counter)];
+  // Single writer: relaxed load+store compiles to a plain add
+  x.store(x.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Gather every thread's counters since the previous call.
+//
+// Returns counts and elapsed time since the previous call (or since start-up)
+RayStats collect_ray_stats();
+
+#endif
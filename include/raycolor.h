@@ -6,6 +6,8 @@
 #include <Eigen/Core>
 #include <vector>
 
+class ObjectBVH;
+
 // Shoot a ray into a lit scene and collect color information.
 //
 // Inputs:
@@ -15,8 +17,12 @@
 //   objects  list of objects (shapes) in the scene
 //   lights  list of lights in the scene
 //   num_recursive_calls  how many times has raycolor been called already
+//   accel  optional top-level BVH built over objects (nullptr to test every
+//     object)
 // Outputs:
 //   rgb  collected color 
+//   hit_id  optional id of the object the ray hits first (-1 if none)
+//   hit_t  optional parametric distance to that hit
 // Returns true iff a hit was found
 bool raycolor(
   const Ray & ray, 
@@ -24,6 +30,34 @@ bool raycolor(
   const std::vector< std::shared_ptr<Object> > & objects,
   const std::vector< std::shared_ptr<Light> > & lights,
   const int num_recursive_calls,
-  Eigen::Vector3d & rgb);
+  Eigen::Vector3d & rgb,
+  const ObjectBVH * accel = nullptr,
+  int * hit_id = nullptr,
+  double * hit_t = nullptr);
+
+// Color collected by a ray whose first hit is already known (the part of
+// raycolor after first_hit).
+//
+// Inputs:
+//   ray  ray that hit
+//   hit_id  index into objects of the object hit
+//   t  parametric distance to the hit
+//   n  unit surface normal at the hit
+//   objects  list of objects (shapes) in the scene
+//   lights  list of lights in the scene
+//   num_recursive_calls  how many times has raycolor been called already
+//   accel  optional top-level BVH built over objects
+// Outputs:
+//   rgb  collected color
+void shade_hit(
+  const Ray & ray,
+  const int hit_id,
+  const double t,
+  const Eigen::Vector3d & n,
+  const std::vector< std::shared_ptr<Object> > & objects,
+  const std::vector< std::shared_ptr<Light> > & lights,
+  const int num_recursive_calls,
+  Eigen::Vector3d & rgb,
+  const ObjectBVH * accel = nullptr);
 
 #endif
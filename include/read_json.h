@@ -8,6 +8,7 @@
 // Forward declaration
 struct Object;
 struct Light;
+class GeometryPager;
 
 // Read a scene description from a .json file
 //
@@ -17,25 +18,37 @@ struct Light;
 //   camera  camera looking at the scene
 //   objects  list of shared pointers to objects
 //   lights  list of shared pointers to lights
+//   dependencies  optional list of files referenced by the scene (e.g., .stl
+//     paths, relative to the .json's directory, as written in the file)
+//   pager  optional pager: soups become LazyMeshes that it loads when first
+//     hit instead of being loaded here. Their bounds come from the soup's
+//     "bounds": [[min],[max]] if given, otherwise from a scan of the .stl.
 inline bool read_json(
   const std::string & filename, 
   Camera & camera,
   std::vector<std::shared_ptr<Object> > & objects,
-  std::vector<std::shared_ptr<Light> > & lights);
+  std::vector<std::shared_ptr<Light> > & lights,
+  std::vector<std::string> * dependencies = nullptr,
+  const std::shared_ptr<GeometryPager> & pager = nullptr);
 
 // Implementation
 
 #include <json.hpp>
-#include "readSTL.h"
+#include "read_stl.h"
 #include "dirname.h"
 #include "Object.h"
 #include "Sphere.h"
 #include "Plane.h"
 #include "Triangle.h"
 #include "TriangleSoup.h"
+#include "Instance.h"
+#include "LazyMesh.h"
+#include "PackedMesh.h"
 #include "Light.h"
 #include "PointLight.h"
 #include "DirectionalLight.h"
+#include "RectLight.h"
+#include "SphereLight.h"
 #include "Material.h"
 #include <Eigen/Geometry>
 #include <fstream>
@@ -46,7 +59,9 @@ inline bool read_json(
   const std::string & filename, 
   Camera & camera,
   std::vector<std::shared_ptr<Object> > & objects,
-  std::vector<std::shared_ptr<Light> > & lights)
+  std::vector<std::shared_ptr<Light> > & lights,
+  std::vector<std::string> * dependencies,
+  const std::shared_ptr<GeometryPager> & pager)
 {
   // Heavily borrowing from
   // https://github.com/yig/graphics101-raycasting/blob/master/parser.cpp
@@ -118,12 +133,31 @@ inline bool read_json(
         light->p = parse_Vector3d(jlight["position"]);
         light->I = parse_Vector3d(jlight["color"]);
         lights.push_back(light);
+      }else if(jlight["type"] == "sphere")
+      {
+        std::shared_ptr<SphereLight> light(new SphereLight());
+        light->p = parse_Vector3d(jlight["position"]);
+        light->radius = jlight["radius"].get<double>();
+        light->I = parse_Vector3d(jlight["color"]);
+        light->samples = jlight.value("samples",light->samples);
+        lights.push_back(light);
+      }else if(jlight["type"] == "rect")
+      {
+        std::shared_ptr<RectLight> light(new RectLight());
+        light->corner = parse_Vector3d(jlight["corner"]);
+        light->edge_u = parse_Vector3d(jlight["edge_u"]);
+        light->edge_v = parse_Vector3d(jlight["edge_v"]);
+        light->I = parse_Vector3d(jlight["color"]);
+        light->samples = jlight.value("samples",light->samples);
+        lights.push_back(light);
       }
     }
   };
   parse_lights(j["lights"],lights);
 
-  auto parse_objects = [&parse_Vector3d,&filename,&materials](
+  if(dependencies) dependencies->clear();
+  auto parse_objects =
+    [&parse_Vector3d,&filename,&materials,&dependencies,&pager](
     const json & j,
     std::vector<std::shared_ptr<Object> > & objects)
   {
@@ -152,34 +186,57 @@ inline bool read_json(
         objects.push_back(tri);
       }else if(jobj["type"] == "soup")
       {
-        std::vector<std::vector<double> > V;
-        std::vector<std::vector<double> > F;
-        std::vector<std::vector<int> > N;
-        {
+        // Soups are packed (welded vertices + BVH) and placed as an instance,
+        // or left for the pager to load when first hit
 #if defined(WIN32) || defined(_WIN32)
 #define PATH_SEPARATOR std::string("\\")
 #else
 #define PATH_SEPARATOR std::string("/")
 #endif
-          const std::string stl_path = jobj["stl"];
-          igl::readSTL(
-              igl::dirname(filename)+
-              PATH_SEPARATOR +
-              stl_path,
-              V,F,N);
+        const std::string stl_path = jobj["stl"];
+        if(dependencies) dependencies->push_back(stl_path);
+        const std::string stl_file =
+          igl::dirname(filename)+PATH_SEPARATOR+stl_path;
+        // "bvh": "sah" (default), "linear" or "median"
+        BVHBuild method = BVHBuild::sah;
+        if(jobj.count("bvh") && !parse_bvh_build(jobj["bvh"],method))
+        {
+          std::cerr<<"Unknown bvh build \""<<jobj["bvh"].get<std::string>()
+            <<"\" for "<<stl_path<<", using sah\n";
         }
-        std::shared_ptr<TriangleSoup> soup(new TriangleSoup());
-        for(int f = 0;f<F.size();f++)
+        // "normals": "flat" (default), "per_vertex" or "per_corner", the
+        // latter keeping edges that bend more than "corner_threshold"
+        // degrees (default 20) sharp
+        MeshNormals normals = MeshNormals::flat;
+        if(jobj.count("normals") && !parse_mesh_normals(jobj["normals"],normals))
+        {
+          std::cerr<<"Unknown normals \""<<jobj["normals"].get<std::string>()
+            <<"\" for "<<stl_path<<", using flat\n";
+        }
+        const double corner_threshold =
+          jobj.count("corner_threshold") ? jobj["corner_threshold"].get<double>() : 20.0;
+        if(pager)
+        {
+          BoundingBox bounds;
+          if(jobj.count("bounds"))
+          {
+            bounds = BoundingBox(
+              parse_Vector3d(jobj["bounds"][0]),
+              parse_Vector3d(jobj["bounds"][1]));
+          }else
+          {
+            read_stl_bounds(stl_file,bounds);
+          }
+          objects.push_back(std::make_shared<LazyMesh>(
+            pager,pager->add(stl_file,method,normals,corner_threshold),bounds));
+        }else
         {
-          std::shared_ptr<Triangle> tri(new Triangle());
-          tri->corners = std::make_tuple(
-            Eigen::Vector3d( V[F[f][0]][0], V[F[f][0]][1], V[F[f][0]][2]),
-            Eigen::Vector3d( V[F[f][1]][0], V[F[f][1]][1], V[F[f][1]][2]),
-            Eigen::Vector3d( V[F[f][2]][0], V[F[f][2]][1], V[F[f][2]][2])
-          );
-          soup->triangles.push_back(tri);
+          std::shared_ptr<PackedMesh> mesh(new PackedMesh());
+          read_stl(stl_file,*mesh);
+          mesh->build_bvh(method);
+          mesh->compute_normals(normals,corner_threshold);
+          objects.push_back(std::make_shared<Instance>(mesh));
         }
-        objects.push_back(soup);
       }
       //objects.back()->material = default_material;
       if(jobj.count("material"))
@@ -0,0 +1,31 @@
+#ifndef READ_STL_H
+#define READ_STL_H
+
+#include "BoundingBox.h"
+#include "PackedMesh.h"
+#include <string>
+
+// Read a binary or ascii .stl file straight into a PackedMesh. The file is
+// memory mapped; binary triangles are decoded in parallel, ascii files go
+// through a single-pass tokenizer, and duplicate corners are welded into
+// shared vertices (see weld_vertices).
+//
+// Inputs:
+//   filename  path to .stl file
+// Outputs:
+//   mesh  mesh.V and mesh.F are filled in; mesh.bvh is left for the caller to
+//     build
+// Returns true on success, false on failure (e.g., can't open file, bad
+// format)
+bool read_stl(const std::string & filename, PackedMesh & mesh);
+// Bounds of the triangles in an .stl file, without welding or building
+// anything (e.g., to place a mesh that is loaded later).
+//
+// Inputs:
+//   filename  path to .stl file
+// Outputs:
+//   bounds  bounding box of all triangle corners
+// Returns true on success, false on failure
+bool read_stl_bounds(const std::string & filename, BoundingBox & bounds);
+
+#endif
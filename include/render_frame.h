@@ -0,0 +1,112 @@
+#ifndef RENDER_FRAME_H
+#define RENDER_FRAME_H
+
+#include "Camera.h"
+#include "RayGenerator.h"
+#include "Scene.h"
+#include "ray_stats.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// What a rendered pixel shows
+enum class RenderMode : int
+{
+  // Shaded colour
+  shaded = 0,
+  // False-colour cost of each pixel: time spent tracing it,
+  heat_cycles,
+  // triangle tests performed,
+  heat_tests,
+  // or mirror bounces reached in raycolor
+  heat_depth,
+  count
+};
+
+// Human-readable name of a render mode
+const char * render_mode_name(const RenderMode mode);
+
+// How a frame is rendered
+struct RenderSettings
+{
+  RenderMode mode = RenderMode::shaded;
+  // Adaptive antialiasing (shaded mode only): after one ray per pixel,
+  // pixels on object, depth or colour edges get aa_grid*aa_grid extra
+  // stratified rays. The strongest edges win when the extra rays would
+  // exceed aa_budget times the number of pixels.
+  bool adaptive_aa = false;
+  double aa_budget = 0.3;
+  int aa_grid = 2;
+  // Selects the random numbers used by this frame (antialiasing jitter, soft
+  // shadows). The same seed reproduces the same image.
+  uint32_t seed = 0;
+  // Shoot each pixel's first ray through a random point of the pixel
+  // instead of its centre (for accumulating passes into an antialiased
+  // image)
+  bool jitter = false;
+  // Block size of the coarse visibility pre-pass (see coarse_visibility.h);
+  // 0 traces every pixel through the BVH
+  int coarse_block = 8;
+  // Camera model (only perspective cameras use the coarse pass)
+  Lens lens;
+};
+
+// Radiance before tone mapping, 3 floats per pixel in row-major order
+struct LinearFrame
+{
+  std::vector<float> rgb;
+  int width = 0;
+  int height = 0;
+  // Rays and tests traced for this frame
+  RayStats stats;
+  // Heatmap modes: mean cost per pixel and the cost drawn as full red
+  double heat_mean = 0;
+  double heat_scale = 0;
+  // Pixels that received extra antialiasing samples
+  int refined_pixels = 0;
+  // Pixels whose first hit came from the coarse visibility pass
+  int planar_pixels = 0;
+};
+
+// 8-bit rgb image ready for display or write_ppm
+struct RenderResult
+{
+  std::vector<unsigned char> pixels;
+  int width = 0;
+  int height = 0;
+  RayStats stats;
+  double heat_mean = 0;
+  double heat_scale = 0;
+  int refined_pixels = 0;
+  int planar_pixels = 0;
+};
+
+// Trace a scene snapshot: one ray per pixel plus any adaptive
+// antialiasing samples.
+//
+// Inputs:
+//   scene  snapshot to render (kept alive by the caller)
+//   cam  camera
+//   width  image width in pixels
+//   height  image height in pixels
+//   settings  render mode and antialiasing
+// Returns linear radiance (or heatmap colours) and the frame's ray stats
+LinearFrame render_linear(
+  const std::shared_ptr<const SceneSnapshot> & scene,
+  const Camera & cam,
+  const int width,
+  const int height,
+  const RenderSettings & settings = RenderSettings());
+
+// Map radiance to 8-bit display values by clamping to [0,1]
+RenderResult tonemap(const LinearFrame & frame);
+
+// render_linear followed by tonemap
+RenderResult render_frame(
+  std::shared_ptr<const SceneSnapshot> scene,
+  const Camera & cam,
+  const int width,
+  const int height,
+  const RenderSettings & settings = RenderSettings());
+
+#endif
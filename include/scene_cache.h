@@ -0,0 +1,93 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include "Camera.h"
+#include "Light.h"
+#include "Object.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class GeometryPager;
+
+// Binary scene cache
+//
+// A cache file holds everything read_json would produce (camera, lights,
+// material table, objects) plus the packed geometry of every mesh together
+// with its prebuilt BVH, so loading it involves no parsing, welding or BVH
+// construction. The file is a header with a table of sections; sections refer
+// to each other by byte offsets, which are turned into pointers into a single
+// memory mapping on load. The header also stores a hash of the contents of the
+// .json and of every file it references: any edit to those (or a format
+// version change) makes the cache stale and it is rewritten.
+
+// Load a .json scene, going through the cache file next to it
+// (scene_cache_path(filename)). A missing or stale cache is rebuilt from the
+// .json after loading it with read_json.
+//
+// Inputs:
+//   filename  path to .json file
+//   pager  optional pager for lazy geometry (see read_json). The cache holds
+//     every mesh fully loaded, so it is bypassed when a pager is given.
+// Outputs:
+//   camera  camera looking at the scene
+//   objects  list of shared pointers to objects
+//   lights  list of shared pointers to lights
+// Returns true iff the scene could be loaded (writing the cache may still
+// have failed)
+bool read_scene_cached(
+  const std::string & filename,
+  Camera & camera,
+  std::vector<std::shared_ptr<Object> > & objects,
+  std::vector<std::shared_ptr<Light> > & lights,
+  const std::shared_ptr<GeometryPager> & pager = nullptr);
+
+// Path of the cache file for a .json scene
+std::string scene_cache_path(const std::string & filename);
+
+// Hash of the .json file and the files it references (paths relative to the
+// .json's directory), as stored in cache headers.
+//
+// Returns true iff all files could be read
+bool scene_content_hash(
+  const std::string & filename,
+  const std::vector<std::string> & dependencies,
+  uint64_t & hash);
+
+// Write a scene to a cache file. Supports Sphere, Plane, Triangle and
+// Instance objects, PointLight and DirectionalLight lights.
+//
+// Inputs:
+//   cache_filename  path of the cache file to (over)write
+//   content_hash  hash of the source files (see scene_content_hash)
+//   dependencies  files referenced by the .json, relative to its directory
+//   camera, objects, lights  scene to store
+// Returns true on success, false if a file can't be written or the scene
+// contains an unsupported object or light type
+bool write_scene_cache(
+  const std::string & cache_filename,
+  const uint64_t content_hash,
+  const std::vector<std::string> & dependencies,
+  const Camera & camera,
+  const std::vector<std::shared_ptr<Object> > & objects,
+  const std::vector<std::shared_ptr<Light> > & lights);
+
+// Read a scene back from a cache file if it is valid and up to date with the
+// .json it was made from.
+//
+// Inputs:
+//   cache_filename  path of the cache file
+//   filename  path of the .json the cache belongs to
+// Outputs:
+//   camera, objects, lights  loaded scene (untouched on failure)
+// Returns true on success, false if the cache is missing, corrupt, of another
+// format version or stale
+bool read_scene_cache(
+  const std::string & cache_filename,
+  const std::string & filename,
+  Camera & camera,
+  std::vector<std::shared_ptr<Object> > & objects,
+  std::vector<std::shared_ptr<Light> > & lights);
+
+#endif
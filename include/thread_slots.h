@@ -0,0 +1,71 @@
+#ifndef THREAD_SLOTS_H
+#define THREAD_SLOTS_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Per-thread instances of T for statistics that threads update without
+// locks and a collector reads. Each thread borrows an instance for its
+// lifetime (see Lease). Instances of exited threads are lent again, contents
+// and all, to new threads, so per-frame std::async workers don't grow the
+// set and nothing a thread counted is lost.
+template <typename T>
+class ThreadSlots
+{
+  public:
+    // Lends an instance to the current thread while it lives. Meant to be
+    // held in a thread_local.
+    class Lease
+    {
+      public:
+        explicit Lease(ThreadSlots & a_slots)
+          : slots(a_slots), item(a_slots.acquire())
+        {
+        }
+        ~Lease()
+        {
+          slots.release(item);
+        }
+        Lease(const Lease &) = delete;
+        Lease & operator=(const Lease &) = delete;
+        T & operator*() const { return *item; }
+      private:
+        ThreadSlots & slots;
+        T * item;
+    };
+    // Call f(index, instance) for every instance created so far (borrowed or
+    // not), in creation order. Indices are stable.
+    template <typename Function>
+    void for_each(Function f)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for(size_t i = 0; i < items.size(); i++)
+      {
+        f(i, *items[i]);
+      }
+    }
+  private:
+    T * acquire()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(unused.empty())
+      {
+        items.push_back(std::make_unique<T>());
+        return items.back().get();
+      }
+      T * item = unused.back();
+      unused.pop_back();
+      return item;
+    }
+    void release(T * item)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      unused.push_back(item);
+    }
+    std::mutex mutex;
+    std::vector<std::unique_ptr<T> > items;
+    std::vector<T *> unused;
+};
+
+#endif
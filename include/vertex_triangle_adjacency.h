@@ -16,4 +16,23 @@ void vertex_triangle_adjacency(
   const Eigen::MatrixXi & F,
   const int num_vertices,
   std::vector<std::vector<int> > & VF);
+// Compressed (CSR) variant: one flat list of incident faces plus offsets, in
+// two allocations instead of one per vertex. Built in parallel over blocks of
+// faces (count, prefix sum, fill) with num_vertices ints of scratch per
+// thread; the output does not depend on the number of threads. Works for any
+// polygon size (e.g., quads).
+//
+// Inputs:
+//   F  #F by poly list of mesh face indices
+//   num_vertices  number of vertices (i.e., V.rows(); usually ==F.maxCoeff()+1)
+// Outputs:
+//   VF  #F*poly list of faces, so that the faces incident on vertex i are
+//     VF(NI(i)) through VF(NI(i+1)-1), in increasing order (a face is listed
+//     once per corner at the vertex)
+//   NI  num_vertices+1 list of offsets into VF
+void vertex_triangle_adjacency(
+  const Eigen::MatrixXi & F,
+  const int num_vertices,
+  Eigen::VectorXi & VF,
+  Eigen::VectorXi & NI);
 #endif
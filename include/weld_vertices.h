@@ -0,0 +1,23 @@
+#ifndef WELD_VERTICES_H
+#define WELD_VERTICES_H
+
+#include "PackedMesh.h"
+#include <vector>
+
+// Merge bitwise-identical corners of a triangle soup (e.g., as stored in an
+// STL file, where each triangle carries its own copy of every corner) into
+// shared vertices. Runs in parallel using a lock-free hash table; the output
+// does not depend on the number of threads.
+//
+// Inputs:
+//   P  #F*3*3 list of corner coordinates: corner c of triangle f is at
+//     P[9*f+3*c+0..2]
+// Outputs:
+//   V  #V by 3 list of unique positions, in order of first appearance in P
+//   F  #F by 3 list of triangle indices into V
+void weld_vertices(
+  const std::vector<float> & P,
+  PackedMesh::VertexMatrix & V,
+  PackedMesh::FaceMatrix & F);
+
+#endif
@@ -9,9 +9,9 @@
 //   V  #V by 3 list of vertex positions
 //   F  #F by poly=(3 or 4) list of mesh face indices into V
 //   UV  #UV by 2 list of UV positions
-//   UF  #F by poly list of mesh face indices into UV
+//   UF  #F by poly list of mesh face indices into UV (may be empty)
 //   NV  #NV by 3 list of normal vectors
-//   NF  #F by poly list of mesh face indices into NV
+//   NF  #F by poly list of mesh face indices into NV (may be empty)
 // Returns true if write was successful
 bool write_obj(
   const std::string & filename,
@@ -4,7 +4,8 @@
 #include <vector>
 #include <string>
 
-// Write an rgb or grayscale image to a .ppm file.
+// Write an rgb or grayscale image to a binary (P6) .ppm file. Grayscale
+// images are expanded to rgb.
 //
 // Inputs:
 //   filename  path to .ppm file as string
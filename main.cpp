@@ -1,70 +1,51 @@
 #define SDL_MAIN_HANDLED
 #include "Camera.h"
+#include "camera_path.h"
+#include "FrameAccumulator.h"
+#include "FrameWriter.h"
+#include "GeometryPager.h"
+#include "Instance.h"
 #include "Light.h"
 #include "Material.h"
+#include "OrbitalCamera.h"
 #include "PointLight.h"
-#include "Triangle.h"
-#include "TriangleSoup.h"
+#include "SphereLight.h"
+#include "Scene.h"
 #include "catmull_clark.h"
 #include "mesh_builders.h"
 #include "mesh_types.h"
-#include "raycolor.h"
-#include "viewing_ray.h"
-#include "write_ppm.h"
+#include "pack_mesh.h"
+#include "profiler.h"
+#include "ray_stats.h"
+#include "render_frame.h"
+#include "scene_cache.h"
 #include <SDL2/SDL.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <future>
 #include <iostream>
 #include <limits>
 #include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace {
 
-struct OrbitalCamera {
-  double yaw = 0.0;
-  double pitch = 0.05;
-  double distance = 2.2;
-  Eigen::Vector3d target = Eigen::Vector3d(0.0, 1.0, 0.0);
-  double vfov = 60.0 * M_PI / 180.0;
-};
-
 struct SceneBuild {
-  std::vector<std::shared_ptr<Object>> objects;
-  std::vector<std::shared_ptr<Light>> lights;
-  std::shared_ptr<PointLight> flashlight;
+  Scene scene;
+  // Light id of the flashlight that follows the camera
+  int flashlight = -1;
+  // Loads the scene's meshes on demand (--lazy), null if they are all loaded
+  // up front
+  std::shared_ptr<GeometryPager> pager;
 };
 
-Eigen::Vector3d camera_forward(double yaw, double pitch) {
-  Eigen::Vector3d f(std::sin(yaw) * std::cos(pitch), std::sin(pitch),
-                    std::cos(yaw) * std::cos(pitch));
-  return f.normalized();
-}
-
-Eigen::Vector3d camera_eye(const OrbitalCamera &o) {
-  Eigen::Vector3d f = camera_forward(o.yaw, o.pitch);
-  return o.target - f * o.distance;
-}
-
-void fill_camera(const OrbitalCamera &o, Camera &cam) {
-  Eigen::Vector3d f = camera_forward(o.yaw, o.pitch);
-  Eigen::Vector3d e = o.target - f * o.distance;
-  Eigen::Vector3d v(0.0, 1.0, 0.0);
-  Eigen::Vector3d w = -f;
-  Eigen::Vector3d u = v.cross(w).normalized();
-  v = w.cross(u).normalized(); // keep v pointing up relative to w/u
-  cam.e = e;
-  cam.w = w;
-  cam.u = u;
-  cam.v = v;
-  cam.d = 1.0;
-  cam.height = 2.0 * cam.d * std::tan(o.vfov * 0.5);
-  cam.width = cam.height * (16.0 / 9.0);
-}
-
 std::shared_ptr<Material> make_material(const Eigen::Vector3d &ka,
                                         const Eigen::Vector3d &kd,
                                         const Eigen::Vector3d &ks,
@@ -79,35 +60,20 @@ std::shared_ptr<Material> make_material(const Eigen::Vector3d &ka,
   return m;
 }
 
-std::shared_ptr<TriangleSoup> quad_mesh_to_soup(
-    const Mesh &mesh, const std::shared_ptr<Material> &mat) {
-  auto soup = std::make_shared<TriangleSoup>();
-  for (int f = 0; f < mesh.F.rows(); ++f) {
-    const int a = mesh.F(f, 0);
-    const int b = mesh.F(f, 1);
-    const int c = mesh.F(f, 2);
-    const int d = mesh.F(f, 3);
-    Eigen::Vector3d va = mesh.V.row(a);
-    Eigen::Vector3d vb = mesh.V.row(b);
-    Eigen::Vector3d vc = mesh.V.row(c);
-    Eigen::Vector3d vd = mesh.V.row(d);
-    auto t0 = std::make_shared<Triangle>();
-    t0->corners = std::make_tuple(va, vb, vc);
-    t0->material = mat;
-    auto t1 = std::make_shared<Triangle>();
-    t1->corners = std::make_tuple(va, vc, vd);
-    t1->material = mat;
-    soup->triangles.push_back(t0);
-    soup->triangles.push_back(t1);
-  }
-  soup->material = mat;
-  return soup;
+std::shared_ptr<const PackedMesh>
+pack(const Mesh &mesh, BVHBuild method = BVHBuild::sah,
+     MeshNormals normals = MeshNormals::flat) {
+  return pack_mesh(mesh.V, mesh.F, method, normals);
 }
 
-Mesh apply_transform(const Mesh &mesh, const Eigen::Vector3d &t) {
-  Mesh out = mesh;
-  out.V = mesh.V.rowwise() + t.transpose();
-  return out;
+// Place shared geometry in the scene; instances never copy the mesh.
+std::shared_ptr<Instance> make_instance(
+    const std::shared_ptr<const PackedMesh> &mesh, const Eigen::Vector3d &t,
+    const std::shared_ptr<Material> &mat) {
+  auto instance = std::make_shared<Instance>(
+      mesh, Eigen::Affine3d(Eigen::Translation3d(t)));
+  instance->material = mat;
+  return instance;
 }
 
 Mesh subdivide_mesh(const Mesh &mesh, int iterations) {
@@ -140,68 +106,65 @@ SceneBuild build_scene() {
                                   Eigen::Vector3d(1.0, 1.0, 1.0), 300.0);
 
   // Room and table
-  Mesh room = build_room_mesh();
-  Mesh table = apply_transform(build_table_mesh(), Eigen::Vector3d(1.6, 0.0, -1.0));
-  S.objects.push_back(quad_mesh_to_soup(room, wall_mat));
-  S.objects.push_back(quad_mesh_to_soup(table, table_mat));
-
-  // Cube on table (subdivided once)
-  Mesh cube = subdivide_mesh(build_cube_mesh(0.6), 1);
-  cube = apply_transform(cube, Eigen::Vector3d(1.6, 1.45, -1.0));
-  S.objects.push_back(quad_mesh_to_soup(cube, metal_mat));
+  auto room = pack(build_room_mesh());
+  auto table = pack(build_table_mesh());
+  S.scene.add_object(make_instance(room, Eigen::Vector3d::Zero(), wall_mat));
+  S.scene.add_object(
+      make_instance(table, Eigen::Vector3d(1.6, 0.0, -1.0), table_mat));
+
+  // Cube on table (subdivided once). Subdivision changes the topology, so
+  // it gets the BVH that is quickest to rebuild. Smooth normals make one
+  // level of subdivision look round.
+  auto cube = pack(subdivide_mesh(build_cube_mesh(0.6), 1), BVHBuild::linear,
+                   MeshNormals::per_vertex);
+  S.scene.add_object(
+      make_instance(cube, Eigen::Vector3d(1.6, 1.45, -1.0), metal_mat));
 
   // Mirror on back wall
-  Mesh mirror = apply_transform(build_mirror_mesh(1.6, 1.0),
-                                Eigen::Vector3d(0.0, 1.6, -2.99));
-  S.objects.push_back(quad_mesh_to_soup(mirror, mirror_mat));
+  auto mirror = pack(build_mirror_mesh(1.6, 1.0));
+  S.scene.add_object(
+      make_instance(mirror, Eigen::Vector3d(0.0, 1.6, -2.99), mirror_mat));
 
   // Lights
   auto overhead = std::make_shared<PointLight>();
   overhead->p = Eigen::Vector3d(0.0, 2.6, 0.0);
   overhead->I = Eigen::Vector3d(0.2, 0.2, 0.2); // dim fill so movable light dominates shadows
-  S.lights.push_back(overhead);
+  S.scene.add_light(overhead);
 
-  S.flashlight = std::make_shared<PointLight>();
-  S.flashlight->p = Eigen::Vector3d(0.0, 1.3, 1.0);
-  S.flashlight->I = Eigen::Vector3d(0.9, 0.8, 0.7); // still soft but brighter than fill
-  S.lights.push_back(S.flashlight);
+  // Small area light, so the shadows it throws have soft edges
+  auto flashlight = std::make_shared<SphereLight>();
+  flashlight->p = Eigen::Vector3d(0.0, 1.3, 1.0);
+  flashlight->radius = 0.06;
+  flashlight->I = Eigen::Vector3d(0.9, 0.8, 0.7); // still soft but brighter than fill
+  S.flashlight = S.scene.add_light(flashlight);
 
+  S.scene.commit();
   return S;
 }
 
-struct RenderResult {
-  std::vector<unsigned char> pixels;
-  int width = 0;
-  int height = 0;
-};
-
-RenderResult render_frame(const SceneBuild &scene,
-                          const Camera &cam,
-                          int width,
-                          int height) {
-  RenderResult result;
-  result.width = width;
-  result.height = height;
-  result.pixels.resize(3 * width * height);
-  auto to_uc = [](double s) {
-    return static_cast<unsigned char>(
-        255.0 * std::max(std::min(s, 1.0), 0.0));
-  };
-
-  #pragma omp parallel for
-  for (int i = 0; i < height; ++i) {
-    for (int j = 0; j < width; ++j) {
-      Eigen::Vector3d rgb(0, 0, 0);
-      Ray ray;
-      viewing_ray(cam, i, j, width, height, ray);
-      raycolor(ray, 1.0, scene.objects, scene.lights, 0, rgb);
-      const int idx = 3 * (j + width * i);
-      result.pixels[idx + 0] = to_uc(rgb(0));
-      result.pixels[idx + 1] = to_uc(rgb(1));
-      result.pixels[idx + 2] = to_uc(rgb(2));
-    }
+// Load a .json scene (through its binary cache) and aim the orbital camera
+// the way the scene's camera looks.
+bool load_json_scene(const std::string &filename, SceneBuild &S,
+                     OrbitalCamera &orbit) {
+  Camera cam;
+  std::vector<std::shared_ptr<Object>> objects;
+  std::vector<std::shared_ptr<Light>> lights;
+  if (!read_scene_cached(filename, cam, objects, lights, S.pager)) {
+    return false;
+  }
+  for (const auto &object : objects) {
+    S.scene.add_object(object);
   }
-  return result;
+  for (const auto &light : lights) {
+    S.scene.add_light(light);
+  }
+  S.scene.commit();
+  const Eigen::Vector3d f = -cam.w.normalized();
+  orbit.yaw = std::atan2(f.x(), f.z());
+  orbit.pitch = std::asin(std::clamp(f.y(), -1.0, 1.0));
+  orbit.target = cam.e + f * orbit.distance;
+  orbit.vfov = 2.0 * std::atan(0.5 * cam.height / cam.d);
+  return true;
 }
 
 void clamp_inside(OrbitalCamera &c) {
@@ -211,9 +174,447 @@ void clamp_inside(OrbitalCamera &c) {
   c.distance = std::clamp(c.distance, 0.4, 6.0);
 }
 
+// Keep the flashlight just below the eye
+void update_flashlight(SceneBuild &build, const Camera &cam) {
+  if (build.flashlight < 0) {
+    return;
+  }
+  Eigen::Vector3d up = cam.v.normalized();
+  build.scene.set_light_position(build.flashlight, cam.e - 0.2 * up);
+}
+
+// Lenses without a focus distance focus on the orbit target
+RenderSettings focus_on_target(RenderSettings settings,
+                               const OrbitalCamera &orbit) {
+  if (settings.lens.focus_distance <= 0) {
+    settings.lens.focus_distance = orbit.distance;
+  }
+  return settings;
+}
+
+// One line of per-stage self times, largest first
+std::string profile_summary(const FrameProfile &profile) {
+  std::vector<int> order(num_profile_stages);
+  for (int s = 0; s < num_profile_stages; ++s) {
+    order[s] = s;
+  }
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return profile.self_ms[a] > profile.self_ms[b];
+  });
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), "frame %.1f ms", profile.wall_ms);
+  std::string summary = buffer;
+  for (int s : order) {
+    if (profile.calls[s] == 0) {
+      continue;
+    }
+    std::snprintf(buffer, sizeof(buffer), " | %s %.1f",
+                  profile_stage_name(static_cast<ProfileStage>(s)),
+                  profile.self_ms[s]);
+    summary += buffer;
+  }
+  return summary;
+}
+
+// Profiler overlay: one bar per stage, its length the stage's share of the
+// frame's CPU time. The numbers go to the window title (profile_summary).
+void draw_profile_overlay(SDL_Renderer *renderer, int width,
+                          const FrameProfile &profile) {
+  static const Uint8 palette[][3] = {
+      {230, 25, 75},  {60, 180, 75},  {255, 225, 25}, {0, 130, 200},
+      {245, 130, 48}, {145, 30, 180}, {70, 240, 240}, {240, 50, 230},
+      {210, 245, 60}, {250, 190, 212}, {170, 110, 40}};
+  static_assert(sizeof(palette) / sizeof(palette[0]) == num_profile_stages,
+                "one colour per profile stage");
+  double sum = 0.0;
+  for (int s = 0; s < num_profile_stages; ++s) {
+    sum += profile.self_ms[s];
+  }
+  if (sum <= 0.0) {
+    return;
+  }
+  const int bar_height = 6;
+  const int max_length = width / 3;
+  for (int s = 0; s < num_profile_stages; ++s) {
+    SDL_Rect bar{8, 8 + s * (bar_height + 2),
+                 std::max(1, static_cast<int>(max_length *
+                                              profile.self_ms[s] / sum)),
+                 bar_height};
+    SDL_SetRenderDrawColor(renderer, palette[s][0], palette[s][1],
+                           palette[s][2], 255);
+    SDL_RenderFillRect(renderer, &bar);
+  }
+}
+
+// Ray statistics of rendered frames: a stdout summary every interval
+// seconds and/or one csv row per frame.
+class StatsLog {
+public:
+  StatsLog(double interval_, const std::string &csv_file)
+      : interval(interval_), last_print(std::chrono::steady_clock::now()) {
+    if (!csv_file.empty()) {
+      csv.open(csv_file);
+      if (!csv) {
+        std::cerr << "Failed to open " << csv_file << "\n";
+      }
+      csv << "frame,render_seconds";
+      for (int c = 0; c < num_ray_counters; ++c) {
+        csv << "," << ray_counter_name(static_cast<RayCounter>(c));
+      }
+      csv << ",rays_per_second,tests_per_ray\n";
+    }
+  }
+  void add(const RayStats &stats) {
+    if (csv.is_open()) {
+      csv << frame << "," << stats.seconds;
+      for (uint64_t count : stats.counts) {
+        csv << "," << count;
+      }
+      csv << "," << stats.rays_per_second() << "," << stats.tests_per_ray()
+          << "\n";
+    }
+    frame++;
+    if (interval <= 0.0) {
+      return;
+    }
+    pending += stats;
+    pending_frames++;
+    const auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - last_print).count() < interval) {
+      return;
+    }
+    std::cout << pending_frames << " frames: " << pending.rays() << " rays, "
+              << pending.rays_per_second() / 1e6 << " Mrays/s, "
+              << pending.tests_per_ray() << " tests/ray, "
+              << double(pending[RayCounter::bvh_node_visits]) /
+                     std::max<uint64_t>(pending.rays(), 1)
+              << " nodes/ray\n";
+    pending = RayStats();
+    pending_frames = 0;
+    last_print = now;
+  }
+
+private:
+  double interval;
+  std::ofstream csv;
+  int frame = 0;
+  RayStats pending;
+  int pending_frames = 0;
+  std::chrono::steady_clock::time_point last_print;
+};
+
+struct Options {
+  // .json scene (e.g., data/bunny.json); empty for the built-in room
+  std::string scene_file;
+  // Offline mode: frames are written to <batch_prefix>NNNN.ppm
+  std::string batch_prefix;
+  // Camera path .json for offline mode (see camera_path.h)
+  std::string path_file;
+  // Chrome trace of the whole run (needs a profiling build)
+  std::string trace_file;
+  // Print ray statistics every stats_interval seconds (0 disables)
+  double stats_interval = 0.0;
+  // One row of ray statistics per frame
+  std::string stats_csv;
+  // Heatmap mode and adaptive antialiasing
+  RenderSettings render;
+  // Jittered passes averaged into each batch frame
+  int passes = 1;
+  // Headless benchmark: render without writing frames
+  bool bench = false;
+  // Memory cap in MB of lazily paged .stl geometry (0 loads it up front)
+  double lazy_mb = 0.0;
+  // Frames of a turntable around the start camera when there is no path
+  int turntable_frames = 1;
+  int width = 1920;
+  int height = 1080;
+};
+
+void print_usage(const char *program) {
+  std::cerr << "Usage: " << program << " [scene.json]\n"
+            << "       " << program
+            << " [scene.json] --batch <prefix> [--path cameras.json |"
+               " --turntable <frames>] [--size <w>x<h>]\n"
+            << "       --trace <trace.json> records a Chrome trace (profiling"
+               " builds)\n"
+            << "       " << program
+            << " [scene.json] --bench <frames> [--path cameras.json]"
+               " [--size <w>x<h>]\n"
+            << "       --heatmap cycles|tests|depth renders per-pixel cost\n"
+            << "       --aa <budget> antialiases edges with at most budget"
+               " extra rays per pixel (e.g. 0.3)\n"
+            << "       --passes <n> averages n jittered passes per batch"
+               " frame\n"
+            << "       --coarse <pixels> sets the block size of the planar"
+               " visibility pre-pass (0 disables it)\n"
+            << "       --camera perspective|orthographic|fisheye|thin_lens"
+               " [--aperture <radius>] [--focus <distance>]\n"
+            << "       --lazy <MB> loads .stl meshes when first hit, keeping"
+               " at most MB of them resident\n"
+            << "       --stats <seconds> prints ray statistics,"
+               " --stats-csv <file> logs them per frame\n";
+}
+
+bool parse_options(int argc, char *argv[], Options &opts) {
+  for (int a = 1; a < argc; ++a) {
+    const std::string arg = argv[a];
+    const bool has_value = a + 1 < argc;
+    if (arg == "--batch" && has_value) {
+      opts.batch_prefix = argv[++a];
+    } else if (arg == "--trace" && has_value) {
+      opts.trace_file = argv[++a];
+    } else if (arg == "--stats" && has_value) {
+      opts.stats_interval = std::atof(argv[++a]);
+    } else if (arg == "--stats-csv" && has_value) {
+      opts.stats_csv = argv[++a];
+    } else if (arg == "--heatmap" && has_value) {
+      const std::string name = argv[++a];
+      opts.render.mode = RenderMode::count;
+      for (int m = 1; m < static_cast<int>(RenderMode::count); ++m) {
+        if (name == render_mode_name(static_cast<RenderMode>(m))) {
+          opts.render.mode = static_cast<RenderMode>(m);
+        }
+      }
+      if (opts.render.mode == RenderMode::count) {
+        return false;
+      }
+    } else if (arg == "--aa" && has_value) {
+      opts.render.adaptive_aa = true;
+      opts.render.aa_budget = std::atof(argv[++a]);
+    } else if (arg == "--passes" && has_value) {
+      opts.passes = std::atoi(argv[++a]);
+      if (opts.passes < 1) {
+        return false;
+      }
+    } else if (arg == "--coarse" && has_value) {
+      opts.render.coarse_block = std::atoi(argv[++a]);
+      if (opts.render.coarse_block < 0) {
+        return false;
+      }
+    } else if (arg == "--camera" && has_value) {
+      const std::string name = argv[++a];
+      opts.render.lens.model = CameraModel::count;
+      for (int m = 0; m < static_cast<int>(CameraModel::count); ++m) {
+        if (name == camera_model_name(static_cast<CameraModel>(m))) {
+          opts.render.lens.model = static_cast<CameraModel>(m);
+        }
+      }
+      if (opts.render.lens.model == CameraModel::count) {
+        return false;
+      }
+    } else if (arg == "--aperture" && has_value) {
+      opts.render.lens.aperture = std::atof(argv[++a]);
+    } else if (arg == "--focus" && has_value) {
+      opts.render.lens.focus_distance = std::atof(argv[++a]);
+    } else if (arg == "--bench" && has_value) {
+      opts.bench = true;
+      opts.turntable_frames = std::atoi(argv[++a]);
+      if (opts.turntable_frames < 1) {
+        return false;
+      }
+    } else if (arg == "--lazy" && has_value) {
+      opts.lazy_mb = std::atof(argv[++a]);
+      if (opts.lazy_mb <= 0) {
+        return false;
+      }
+    } else if (arg == "--path" && has_value) {
+      opts.path_file = argv[++a];
+    } else if (arg == "--turntable" && has_value) {
+      opts.turntable_frames = std::atoi(argv[++a]);
+      if (opts.turntable_frames < 1) {
+        return false;
+      }
+    } else if (arg == "--size" && has_value) {
+      if (std::sscanf(argv[++a], "%dx%d", &opts.width, &opts.height) != 2 ||
+          opts.width < 1 || opts.height < 1) {
+        return false;
+      }
+    } else if (arg.rfind("--", 0) != 0 && opts.scene_file.empty()) {
+      opts.scene_file = arg;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Fill the scene and starting camera from the options (room or .json).
+bool load_scene(const Options &opts, SceneBuild &build, OrbitalCamera &orbit) {
+  if (opts.scene_file.empty()) {
+    build = build_scene();
+    clamp_inside(orbit);
+    return true;
+  }
+  if (opts.lazy_mb > 0) {
+    build.pager = std::make_shared<GeometryPager>(
+        static_cast<size_t>(opts.lazy_mb * 1024.0 * 1024.0));
+  }
+  if (!load_json_scene(opts.scene_file, build, orbit)) {
+    std::cerr << "Failed to load scene " << opts.scene_file << "\n";
+    return false;
+  }
+  return true;
+}
+
+// Render a camera path to numbered .ppm files without opening a window
+// (or, for --bench, just time it). Frame k+1 renders (on every core) while
+// frame k is tone mapped and written in the background.
+int run_batch(const Options &opts, SceneBuild &build, OrbitalCamera orbit) {
+  std::vector<OrbitalCamera> path;
+  if (!opts.path_file.empty()) {
+    if (!read_camera_path(opts.path_file, orbit, path)) {
+      std::cerr << "Failed to read camera path " << opts.path_file << "\n";
+      return 1;
+    }
+  } else {
+    turntable_path(orbit, opts.turntable_frames, path);
+  }
+  const bool room = opts.scene_file.empty();
+  const double aspect = double(opts.width) / double(opts.height);
+
+  FrameWriter writer;
+  StatsLog stats_log(opts.stats_interval, opts.stats_csv);
+  RayStats total_stats;
+  double heat_mean = 0.0;
+  double planar_fraction = 0.0;
+  std::future<void> finishing;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t f = 0; f < path.size(); ++f) {
+    if (room) {
+      clamp_inside(path[f]);
+    }
+    Camera cam;
+    std::shared_ptr<const SceneSnapshot> snapshot;
+    {
+      RT_PROFILE_SCOPE(camera_setup);
+      fill_camera(path[f], cam, aspect);
+      update_flashlight(build, cam);
+      snapshot = build.scene.commit();
+    }
+    const RenderSettings frame_settings = focus_on_target(opts.render, path[f]);
+    uint64_t loads = 0;
+    if (build.pager) {
+      build.pager->next_frame();
+      loads = build.pager->loads();
+    }
+    LinearFrame frame =
+        render_linear(snapshot, cam, opts.width, opts.height, frame_settings);
+    // Meshes first hit during the frame showed as boxes; render it again
+    // once they are in
+    while (build.pager && build.pager->wait_idle() != loads) {
+      loads = build.pager->loads();
+      frame =
+          render_linear(snapshot, cam, opts.width, opts.height, frame_settings);
+    }
+    if (opts.passes > 1) {
+      FrameAccumulator accumulator;
+      accumulator.add(frame);
+      RenderSettings settings = frame_settings;
+      settings.jitter = true;
+      settings.adaptive_aa = false;
+      RayStats stats = frame.stats;
+      for (int p = 1; p < opts.passes; ++p) {
+        settings.seed = opts.render.seed + static_cast<uint32_t>(p);
+        const LinearFrame pass =
+            render_linear(snapshot, cam, opts.width, opts.height, settings);
+        accumulator.add(pass);
+        stats += pass.stats;
+      }
+      const double heat = frame.heat_mean;
+      const double scale = frame.heat_scale;
+      frame = accumulator.average();
+      frame.stats = stats;
+      frame.heat_mean = heat;
+      frame.heat_scale = scale;
+    }
+    stats_log.add(frame.stats);
+    total_stats += frame.stats;
+    heat_mean += frame.heat_mean / path.size();
+    planar_fraction += double(frame.planar_pixels) /
+                       (double(opts.width) * opts.height * path.size());
+    if (opts.bench) {
+      continue;
+    }
+
+    char number[16];
+    std::snprintf(number, sizeof(number), "%04d", static_cast<int>(f));
+    const std::string name = opts.batch_prefix + number + ".ppm";
+    if (finishing.valid()) {
+      finishing.get();
+    }
+    finishing = std::async(
+        std::launch::async, [&writer, name, frame = std::move(frame)]() {
+          RenderResult image = tonemap(frame);
+          writer.write(name, std::move(image.pixels), image.width,
+                       image.height, 3);
+        });
+    std::cout << "Rendered " << name << " (" << f + 1 << "/" << path.size()
+              << ")\n";
+    if (profiler_compiled) {
+      std::cout << "  " << profile_summary(profile_collect()) << "\n";
+    }
+  }
+  if (finishing.valid()) {
+    finishing.get();
+  }
+  const int failures = writer.flush();
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  std::cout << path.size() << " frames in " << seconds << " s ("
+            << path.size() / seconds << " fps), "
+            << total_stats.rays_per_second() / 1e6 << " Mrays/s, "
+            << total_stats.tests_per_ray() << " tests/ray, "
+            << 100.0 * planar_fraction << "% of pixels in planar blocks\n";
+  if (build.pager) {
+    std::cout << build.pager->loads() << " mesh loads, "
+              << build.pager->resident_bytes() / (1024.0 * 1024.0)
+              << " MB resident\n";
+  }
+  if (opts.render.mode != RenderMode::shaded) {
+    std::cout << "mean " << render_mode_name(opts.render.mode)
+              << " per pixel: " << heat_mean << "\n";
+  }
+  if (failures > 0) {
+    std::cerr << failures << " frames could not be written\n";
+    return 1;
+  }
+  return 0;
+}
+
 } // namespace
 
-int main(int /*argc*/, char * /*argv*/[]) {
+int main(int argc, char *argv[]) {
+  Options opts;
+  if (!parse_options(argc, argv, opts)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  SceneBuild build;
+  OrbitalCamera orbit;
+  orbit.yaw = 0.0;
+  orbit.pitch = 0.05;
+  orbit.distance = 2.2;
+  orbit.target = Eigen::Vector3d(0.0, 1.0, 0.0);
+  if (!load_scene(opts, build, orbit)) {
+    return 1;
+  }
+  if (!opts.trace_file.empty()) {
+    if (!profiler_compiled) {
+      std::cerr << "--trace needs a build with -DRT_PROFILE=ON\n";
+    }
+    profile_start_trace(opts.trace_file);
+  }
+  // Writes the trace however main returns
+  struct TraceGuard {
+    ~TraceGuard() { profile_stop_trace(); }
+  } trace_guard;
+  if (!opts.batch_prefix.empty() || opts.bench) {
+    return run_batch(opts, build, orbit);
+  }
+  const bool room = opts.scene_file.empty();
+  Scene &scene = build.scene;
+
   SDL_SetMainReady();
   if (SDL_Init(SDL_INIT_VIDEO) != 0) {
     std::cerr << "Failed to initialize SDL2: " << SDL_GetError() << "\n";
@@ -241,45 +642,75 @@ int main(int /*argc*/, char * /*argv*/[]) {
     return 1;
   }
 
-  SceneBuild scene = build_scene();
-  OrbitalCamera orbit;
-  orbit.yaw = 0.0;
-  orbit.pitch = 0.05;
-  orbit.distance = 2.2;
-  orbit.target = Eigen::Vector3d(0.0, 1.0, 0.0);
-  clamp_inside(orbit);
-
   int width = base_width;
   int height = base_height;
   SDL_Texture *texture = SDL_CreateTexture(
       renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING, width,
       height);
 
-  auto update_flashlight = [&](const Camera &cam) {
-    Eigen::Vector3d up = cam.v.normalized();
-    scene.flashlight->p = cam.e - 0.2 * up;
-  };
-
-  auto request_render = [&](OrbitalCamera &orb, std::future<RenderResult> &job,
-                            bool &inflight) {
-    clamp_inside(orb);
+  // H cycles through the heatmap modes, Q toggles adaptive antialiasing
+  RenderSettings render = opts.render;
+  bool settings_changed = false;
+
+  // While the view stays put, idle time renders further jittered passes
+  // that are averaged into the displayed image. view_generation counts
+  // view changes (camera, settings, window size); passes are only blended
+  // into an accumulation started for the current view.
+  const int max_accumulated_passes = 128;
+  FrameAccumulator accumulator;
+  uint64_t view_generation = 0;
+  uint64_t accumulated_generation = std::numeric_limits<uint64_t>::max();
+  uint64_t job_generation = 0;
+  int job_pass = 0;
+  // Paged-in meshes replace their placeholder boxes, which changes the view
+  uint64_t seen_loads = 0;
+
+  auto request_render = [&](OrbitalCamera &orb, std::future<LinearFrame> &job,
+                            bool &inflight, const int pass) {
+    if (room) {
+      clamp_inside(orb);
+    }
     Camera cam;
-    fill_camera(orb, cam);
-    update_flashlight(cam);
+    std::shared_ptr<const SceneSnapshot> snapshot;
+    {
+      RT_PROFILE_SCOPE(camera_setup);
+      fill_camera(orb, cam);
+      update_flashlight(build, cam);
+      snapshot = scene.commit();
+    }
+    if (build.pager) {
+      build.pager->next_frame();
+    }
     inflight = true;
+    job_generation = view_generation;
+    job_pass = pass;
+    RenderSettings settings = focus_on_target(render, orb);
+    if (pass > 0) {
+      // Jittered pixel positions antialias the average on their own
+      settings.seed = static_cast<uint32_t>(pass);
+      settings.jitter = true;
+      settings.adaptive_aa = false;
+    }
     const int w = width;
     const int h = height;
-    job = std::async(std::launch::async, render_frame, std::cref(scene), cam,
-                     w, h);
+    // The job keeps its snapshot alive; later edits publish new ones
+    job = std::async(std::launch::async, render_linear, snapshot, cam, w, h,
+                     settings);
   };
 
   bool running = true;
   bool rotating = false;
   int last_key_rotate = 0;
   bool inflight = false;
-  std::future<RenderResult> render_job;
+  std::future<LinearFrame> render_job;
   RenderResult latest;
-  request_render(orbit, render_job, inflight);
+  StatsLog stats_log(opts.stats_interval, opts.stats_csv);
+  // F3 toggles the per-stage profiler overlay
+  bool show_profile = false;
+  FrameProfile profile;
+  // F12 saves the displayed frame without stalling the render loop
+  FrameWriter screenshots;
+  int screenshot_count = 0;
 
   while (running) {
     SDL_Event ev;
@@ -316,6 +747,41 @@ int main(int /*argc*/, char * /*argv*/[]) {
       case SDL_KEYDOWN:
         if (ev.key.keysym.sym == SDLK_ESCAPE) {
           running = false;
+        } else if (ev.key.keysym.sym == SDLK_h) {
+          render.mode = static_cast<RenderMode>(
+              (static_cast<int>(render.mode) + 1) %
+              static_cast<int>(RenderMode::count));
+          std::cout << "Render mode: " << render_mode_name(render.mode)
+                    << "\n";
+          settings_changed = true;
+        } else if (ev.key.keysym.sym == SDLK_q) {
+          render.adaptive_aa = !render.adaptive_aa;
+          std::cout << "Adaptive antialiasing "
+                    << (render.adaptive_aa ? "on" : "off") << "\n";
+          settings_changed = true;
+        } else if (ev.key.keysym.sym == SDLK_c) {
+          render.lens.model = static_cast<CameraModel>(
+              (static_cast<int>(render.lens.model) + 1) %
+              static_cast<int>(CameraModel::count));
+          std::cout << "Camera: " << camera_model_name(render.lens.model)
+                    << "\n";
+          settings_changed = true;
+        } else if (ev.key.keysym.sym == SDLK_F3) {
+          show_profile = !show_profile;
+          if (show_profile && !profiler_compiled) {
+            std::cout << "Profiler overlay needs a build with "
+                         "-DRT_PROFILE=ON\n";
+          }
+          if (!show_profile) {
+            SDL_SetWindowTitle(window, "Realtime ray tracing (CPU)");
+          }
+        } else if (ev.key.keysym.sym == SDLK_F12 && !latest.pixels.empty()) {
+          const std::string name =
+              "screenshot-" + std::to_string(screenshot_count++) + ".ppm";
+          std::vector<unsigned char> pixels = latest.pixels;
+          screenshots.write(name, std::move(pixels), latest.width,
+                            latest.height, 3);
+          std::cout << "Saving " << name << "\n";
         } else if (ev.key.keysym.sym == SDLK_LEFT ||
                    ev.key.keysym.sym == SDLK_RIGHT ||
                    ev.key.keysym.sym == SDLK_UP ||
@@ -382,28 +848,60 @@ int main(int /*argc*/, char * /*argv*/[]) {
       camera_changed = true;
     }
 
-    if (camera_changed && !inflight) {
-      request_render(orbit, render_job, inflight);
+    if (build.pager && build.pager->loads() != seen_loads) {
+      seen_loads = build.pager->loads();
+      settings_changed = true;
+    }
+    if (camera_changed || settings_changed) {
+      view_generation++;
+      settings_changed = false;
+    }
+    if (!inflight) {
+      if (accumulated_generation != view_generation) {
+        request_render(orbit, render_job, inflight, 0);
+      } else if (render.mode == RenderMode::shaded &&
+                 accumulator.passes() < max_accumulated_passes) {
+        request_render(orbit, render_job, inflight, accumulator.passes());
+      }
     }
 
     if (inflight &&
         render_job.wait_for(std::chrono::milliseconds(0)) ==
             std::future_status::ready) {
-      RenderResult res = render_job.get();
+      LinearFrame res = render_job.get();
       inflight = false;
-      if (res.width == width && res.height == height &&
-          static_cast<int>(res.pixels.size()) == width * height * 3) {
-        latest = std::move(res);
-      } else {
-        request_render(orbit, render_job, inflight);
+      if (res.width == width && res.height == height) {
+        stats_log.add(res.stats);
+        if (job_pass == 0) {
+          // Shown even if the view moved meanwhile; the next idle loop
+          // starts over for the new view
+          accumulator.reset();
+          accumulated_generation = job_generation;
+          latest = accumulator.add(res);
+        } else if (job_generation == accumulated_generation &&
+                   job_generation == view_generation) {
+          latest = accumulator.add(res);
+        }
+        // Everything since the previous frame arrived
+        profile = profile_collect();
+        if (show_profile) {
+          SDL_SetWindowTitle(window, profile_summary(profile).c_str());
+        }
       }
     }
 
     if (!latest.pixels.empty() && texture &&
         latest.width == width && latest.height == height) {
-      SDL_UpdateTexture(texture, nullptr, latest.pixels.data(), width * 3);
+      {
+        RT_PROFILE_SCOPE(texture_upload);
+        SDL_UpdateTexture(texture, nullptr, latest.pixels.data(), width * 3);
+      }
+      RT_PROFILE_SCOPE(present);
       SDL_RenderClear(renderer);
       SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+      if (show_profile) {
+        draw_profile_overlay(renderer, width, profile);
+      }
       SDL_RenderPresent(renderer);
     } else {
       SDL_SetRenderDrawColor(renderer, 10, 10, 14, 255);
@@ -0,0 +1,35 @@
+#include "Plane.h"
+#include <cmath>
+
+static bool in_footprint_plane(const Plane & plane, const Beam & beam)
+{
+  return std::abs(beam.normal.dot(plane.normal.normalized())) > 1.0-1e-9 &&
+    std::abs(beam.plane_distance(plane.point)) <= beam.tolerance;
+}
+
+bool Plane::intersects_beam(const Beam & beam) const
+{
+  if(in_footprint_plane(*this,beam))
+  {
+    return false;
+  }
+  // Inside the beam iff the beam's corners are not all on one side
+  const auto side = [&](const Eigen::Vector3d & p)
+  {
+    return normal.dot(p-point) > 0;
+  };
+  const bool apex_side = side(beam.apex);
+  for(const Eigen::Vector3d & p : beam.footprint)
+  {
+    if(side(p) != apex_side)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Plane::covers_beam(const Beam & beam) const
+{
+  return in_footprint_plane(*this,beam);
+}
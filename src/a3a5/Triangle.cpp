@@ -1,11 +1,13 @@
 #include "Triangle.h"
 #include "Ray.h"
+#include "ray_stats.h"
 #include <Eigen/Dense>
 #include <Eigen/src/Core/Matrix.h>
 #include <cmath>
 
-bool Triangle::intersect(const Ray &ray, const double min_t, double &t,
-                         Eigen::Vector3d &n) const {
+bool Triangle::closest_hit(const Ray &ray, const double min_t,
+                           const double max_t, Hit &hit) const {
+  count_ray_stat(RayCounter::triangle_tests);
   ////////////////////////////////////////////////////////////////////////////
   // ((b-a) * x + (c-a) * y) = (q-a)
   // x + y <=1;
@@ -35,18 +37,41 @@ bool Triangle::intersect(const Ray &ray, const double min_t, double &t,
              (a * helper_F - b * helper_B + c * helper_E);
   double v = (a * helper_D - b * helper_C + d1 * helper_E) /
              (a * helper_F - b * helper_B + c * helper_E);
-  if (s > min_t && u + v <= 1 && u >= 0 && v >= 0) {
-    t = s;
-    Eigen::Vector3d n_t =
-        (std::get<1>(this->corners) - std::get<0>(this->corners))
-            .cross(std::get<2>(this->corners) - std::get<0>(this->corners));
-    n_t = n_t.normalized();
-    if (n_t.dot(ray.direction) > 0) {
-      n = -n_t;
-    } else {
-      n = n_t;
-    }
+  if (s > min_t && s < max_t && u + v <= 1 && u >= 0 && v >= 0) {
+    hit.t = s;
+    hit.u = u;
+    hit.v = v;
     return true;
   }
   return false;
 }
+
+Eigen::Vector3d Triangle::surface_normal(const Ray &ray,
+                                         const Hit & /*hit*/) const {
+  Eigen::Vector3d n_t =
+      (std::get<1>(this->corners) - std::get<0>(this->corners))
+          .cross(std::get<2>(this->corners) - std::get<0>(this->corners));
+  n_t = n_t.normalized();
+  if (n_t.dot(ray.direction) > 0) {
+    return -n_t;
+  }
+  return n_t;
+}
+
+BoundingBox Triangle::bounding_box() const {
+  BoundingBox box;
+  box.extend(std::get<0>(this->corners));
+  box.extend(std::get<1>(this->corners));
+  box.extend(std::get<2>(this->corners));
+  return box;
+}
+
+bool Triangle::intersects_beam(const Beam &beam) const {
+  return !beam.outside(std::get<0>(corners), std::get<1>(corners),
+                       std::get<2>(corners));
+}
+
+bool Triangle::covers_beam(const Beam &beam) const {
+  return beam.covered_by(std::get<0>(corners), std::get<1>(corners),
+                         std::get<2>(corners));
+}
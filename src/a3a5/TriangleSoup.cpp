@@ -3,22 +3,33 @@
 // Hint
 #include <memory>
 
-bool TriangleSoup::intersect(const Ray &ray, const double min_t, double &t,
-                             Eigen::Vector3d &n) const {
+bool TriangleSoup::closest_hit(const Ray &ray, const double min_t,
+                               const double max_t, Hit &hit) const {
   ////////////////////////////////////////////////////////////////////////////
-  t = std::numeric_limits<double>::infinity();
-  double tmp_t;
-  Eigen::Vector3d tmp_n;
-  bool hit = false;
-  for (std::shared_ptr<Object> tri: this->triangles) {
-    if (tri->intersect(ray, min_t, tmp_t, tmp_n)){
-      if (tmp_t < t) {
-        t = tmp_t;
-        n = tmp_n;
-        hit = true;
-      }
+  double closest_t = max_t;
+  Hit tmp_hit;
+  bool found = false;
+  for (int i = 0; i < static_cast<int>(this->triangles.size()); i++) {
+    if (this->triangles[i]->closest_hit(ray, min_t, closest_t, tmp_hit)) {
+      closest_t = tmp_hit.t;
+      hit = tmp_hit;
+      hit.primitive = i;
+      found = true;
     }
   }
-  return hit;
+  return found;
   ////////////////////////////////////////////////////////////////////////////
 }
+
+Eigen::Vector3d TriangleSoup::surface_normal(const Ray &ray,
+                                             const Hit &hit) const {
+  return this->triangles[hit.primitive]->surface_normal(ray, hit);
+}
+
+BoundingBox TriangleSoup::bounding_box() const {
+  BoundingBox box;
+  for (const std::shared_ptr<Object> &tri : this->triangles) {
+    box.extend(tri->bounding_box());
+  }
+  return box;
+}
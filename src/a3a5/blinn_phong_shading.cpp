@@ -1,17 +1,79 @@
 #include "blinn_phong_shading.h"
 // Hint:
 #include "Light.h"
+#include "PixelSampler.h"
 #include "first_hit.h"
+#include "profiler.h"
+#include "ray_stats.h"
 #include <Eigen/src/Core/Matrix.h>
 #include <algorithm>
 #include <cmath>
 #include <iostream>
 
+// Whether nothing blocks the segment from p along l_dir up to max_t
+static bool unoccluded(const Eigen::Vector3d &p, const Eigen::Vector3d &l_dir,
+                       const double max_t,
+                       const std::vector<std::shared_ptr<Object>> &objects,
+                       const ObjectBVH *accel) {
+  int shadow_hit_id;
+  double shadow_t;
+  Eigen::Vector3d shadow_n;
+  Ray shadow_ray{p + 1e-6 * l_dir.normalized(), l_dir.normalized()};
+  RT_PROFILE_SCOPE(shadow_rays);
+  count_ray_stat(RayCounter::shadow_rays);
+  // Occluders beyond the light never need to be found
+  return !first_hit(shadow_ray, 1e-6, objects, shadow_hit_id, shadow_t,
+                    shadow_n, accel, max_t);
+}
+
+// Fraction of light l (the lights' index-th) visible from p. Lights without
+// area take one shadow ray. Area lights are split into a k x k grid of
+// strata and take one jittered sample per pass, in the stratum the pixel's
+// sampler picks for that pass, so accumulated passes converge to the
+// stratified estimate. At the first hit the outcome is reported to the
+// sampler; where neighbouring pixels disagree (a penumbra) the renderer
+// traces the pixel again with all_strata set, and then every stratum is
+// sampled. Jitter comes from the pixel's sampler, so it is reproducible.
+static double visibility(const Light &l, const int index,
+                         const Eigen::Vector3d &p,
+                         const std::vector<std::shared_ptr<Object>> &objects,
+                         const ObjectBVH *accel) {
+  const int max_samples = l.max_shadow_samples();
+  Eigen::Vector3d l_dir;
+  double max_t;
+  if (max_samples <= 1) {
+    l.direction(p, l_dir, max_t);
+    return unoccluded(p, l_dir, max_t, objects, accel) ? 1.0 : 0.0;
+  }
+  const int k = static_cast<int>(std::ceil(std::sqrt(double(max_samples))));
+  const int n = k * k;
+  PixelSampler &sampler = this_thread_sampler();
+  auto sample = [&](const int s) {
+    const double u = (s % k + sampler.next()) / k;
+    const double v = (s / k + sampler.next()) / k;
+    l.sample_direction(p, u, v, l_dir, max_t);
+    return unoccluded(p, l_dir, max_t, objects, accel);
+  };
+  if (sampler.all_strata && sampler.at_first_hit) {
+    int lit = 0;
+    for (int s = 0; s < n; ++s) {
+      lit += sample(s);
+    }
+    return double(lit) / n;
+  }
+  const bool lit = sample(sampler.stratum(n));
+  if (sampler.at_first_hit) {
+    (lit ? sampler.shadow_lit : sampler.shadow_blocked) |= 1u << (index % 32);
+  }
+  return lit ? 1.0 : 0.0;
+}
+
 Eigen::Vector3d
 blinn_phong_shading(const Ray &ray, const int &hit_id, const double &t,
                     const Eigen::Vector3d &n,
                     const std::vector<std::shared_ptr<Object>> &objects,
-                    const std::vector<std::shared_ptr<Light>> &lights) {
+                    const std::vector<std::shared_ptr<Light>> &lights,
+                    const ObjectBVH *accel) {
   ////////////////////////////////////////////////////////////////////////////
   // Replace with your code here:
   Eigen::Vector3d L = Eigen::Vector3d(0, 0, 0);
@@ -22,23 +84,16 @@ blinn_phong_shading(const Ray &ray, const int &hit_id, const double &t,
   Eigen::Vector3d p = ray.origin + ray.direction * t;
   auto obj = objects[hit_id];
 
-  for (auto l : lights) {
-    // check if its in shadow
+  for (size_t i = 0; i < lights.size(); ++i) {
+    const auto &l = lights[i];
+    // check if its in shadow (partly, for area lights)
+    const double lit = visibility(*l, static_cast<int>(i), p, objects, accel);
+    if (lit == 0.0)
+      continue;
     double max_t;
     Eigen::Vector3d l_dir;
     l->direction(p, l_dir, max_t);
 
-    int shadow_hit_id;
-    double shadow_t;
-    Eigen::Vector3d shadow_n;
-    Ray shadow_ray{p + 1e-6 * l_dir.normalized(), l_dir.normalized()};
-    if (first_hit(shadow_ray, 1e-6, objects, shadow_hit_id, shadow_t,
-                  shadow_n)) {
-      if (shadow_t < max_t)
-        // in shadow, ignore
-        continue;
-    }
-
     // diffuse light
     Eigen::Vector3d Id = obj->material->kd.cwiseProduct(l->I) *
                          std::max(0.0, n.normalized().dot(l_dir.normalized()));
@@ -50,8 +105,8 @@ blinn_phong_shading(const Ray &ray, const int &hit_id, const double &t,
         obj->material->ks.cwiseProduct(l->I) *
         pow(std::max(0.0, n.dot(h)), obj->material->phong_exponent);
 
-    L += Id;
-    L += Is;
+    L += lit * Id;
+    L += lit * Is;
   }
   return L;
   ////////////////////////////////////////////////////////////////////////////
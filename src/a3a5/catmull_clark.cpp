@@ -1,4 +1,5 @@
 #include "catmull_clark.h"
+#include "vertex_triangle_adjacency.h"
 #include <Eigen/Core>
 #include <algorithm>
 #include <map>
@@ -52,33 +53,31 @@ void catmull_clark(const Eigen::MatrixXd &V, const Eigen::MatrixXi &F,
     edge_positions.push_back(e);
   }
 
-  std::vector<std::vector<int>> VF(V.rows());
-  std::vector<std::vector<int>> VE(V.rows());
-  for (int i = 0; i < F.rows(); i++) {
-    for (int j = 0; j < 4; j++) {
-      int a = F(i, j);
-      VF[a].push_back(i);
-      std::pair<int, int> ordered =
-          std::pair<int, int>(std::min(F(i, j), F(i, (j + 1) % 4)),
-                              std::max(F(i, j), F(i, (j + 1) % 4)));
-      VE[a].push_back(edge_idx[ordered]);
-    }
-  }
+  Eigen::VectorXi VF, NI;
+  vertex_triangle_adjacency(F, V.rows(), VF, NI);
 
   std::vector<Eigen::RowVector3d> new_vertices(
       V.rows(), Eigen::RowVector3d::Zero());
+  #pragma omp parallel for
   for (int v = 0; v < V.rows(); v++) {
-    int n = VF[v].size();
+    int n = NI(v + 1) - NI(v);
     if (n == 0) {
       new_vertices[v] = V.row(v);
       continue;
     }
+    // Each incident face contributes its face point and the edge leaving v
     Eigen::RowVector3d Fsum = Eigen::RowVector3d::Zero(),
                        Rsum = Eigen::RowVector3d::Zero();
-    for (int f : VF[v])
+    for (int k = NI(v); k < NI(v + 1); k++) {
+      const int f = VF(k);
       Fsum += face_points.row(f);
-    for (int e : VE[v])
-      Rsum += edge_positions[e];
+      int j = 0;
+      while (F(f, j) != v)
+        j++;
+      const int w = F(f, (j + 1) % 4);
+      Rsum += edge_positions[edge_idx.at(
+          std::pair<int, int>(std::min(v, w), std::max(v, w)))];
+    }
     const double n_double = static_cast<double>(n);
     const Eigen::RowVector3d Favg = Fsum / n_double;
     const Eigen::RowVector3d Ravg = Rsum / n_double;
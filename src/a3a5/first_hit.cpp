@@ -1,5 +1,6 @@
 #include "first_hit.h"
 #include "Object.h"
+#include "ObjectBVH.h"
 #include <Eigen/src/Core/util/Constants.h>
 #include <limits>
 #include <memory>
@@ -10,23 +11,30 @@ bool first_hit(
   const std::vector< std::shared_ptr<Object> > & objects,
   int & hit_id, 
   double & t,
-  Eigen::Vector3d & n)
+  Eigen::Vector3d & n,
+  const ObjectBVH * accel,
+  const double max_t)
 {
   ////////////////////////////////////////////////////////////////////////////
-  double tmp_t;
-  Eigen::Vector3d tmp_n;
-  t = std::numeric_limits<double>::infinity();
+  if (accel) {
+    return accel->first_hit(ray, min_t, objects, hit_id, t, n, max_t);
+  }
+  Hit hit, tmp_hit;
+  hit.t = max_t;
   bool ret = false;
   for (unsigned long i = 0; i < objects.size(); i++) {
-    auto obj = objects[i];
-    bool found = obj->intersect(ray, min_t, tmp_t, tmp_n);
-    if (found && tmp_t <= t) {
-      t = tmp_t;
-      n = tmp_n;
+    // Only hits closer than the current best count
+    if (objects[i]->closest_hit(ray, min_t, hit.t, tmp_hit)) {
+      hit = tmp_hit;
       hit_id = i;
       ret = true;
     }
   }
+  t = hit.t;
+  if (ret) {
+    // Surface of the winner only
+    n = objects[hit_id]->surface_normal(ray, hit);
+  }
   return ret;
   ////////////////////////////////////////////////////////////////////////////
 }
@@ -0,0 +1,47 @@
+#include "per_corner_normals.h"
+#include "triangle_area_normal.h"
+#include "vertex_triangle_adjacency.h"
+#include <cmath>
+
+void per_corner_normals(
+  const Eigen::MatrixXd & V,
+  const Eigen::MatrixXi & F,
+  const double corner_threshold,
+  Eigen::MatrixXd & N)
+{
+  ////////////////////////////////////////////////////////////////////////////
+  // Area normals (for the weights) and unit normals (for the angle test)
+  Eigen::MatrixXd A(F.rows(), 3);
+  Eigen::MatrixXd U(F.rows(), 3);
+  #pragma omp parallel for
+  for (int f = 0; f < F.rows(); f++) {
+    A.row(f) =
+        triangle_area_normal(V.row(F(f, 0)), V.row(F(f, 1)), V.row(F(f, 2)));
+    const double norm = A.row(f).norm();
+    U.row(f) = norm > 0 ? Eigen::RowVector3d(A.row(f) / norm)
+                        : Eigen::RowVector3d::Zero();
+  }
+  Eigen::VectorXi VF, NI;
+  vertex_triangle_adjacency(F, V.rows(), VF, NI);
+  const double min_cos = std::cos(corner_threshold * M_PI / 180.0);
+  N.resize(3 * F.rows(), 3);
+  #pragma omp parallel for
+  for (int f = 0; f < F.rows(); f++) {
+    for (int c = 0; c < 3; c++) {
+      // Average over the faces around this corner's vertex that bend less
+      // than the threshold away from face f (f itself always counts)
+      Eigen::RowVector3d n = Eigen::RowVector3d::Zero();
+      const int v = F(f, c);
+      for (int k = NI(v); k < NI(v + 1); k++) {
+        const int g = VF(k);
+        if (g == f || U.row(g).dot(U.row(f)) >= min_cos) {
+          n += A.row(g);
+        }
+      }
+      const double norm = n.norm();
+      N.row(3 * f + c) = norm > 0 ? Eigen::RowVector3d(n / norm)
+                                  : Eigen::RowVector3d(U.row(f));
+    }
+  }
+  ////////////////////////////////////////////////////////////////////////////
+}
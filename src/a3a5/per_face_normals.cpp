@@ -0,0 +1,21 @@
+#include "per_face_normals.h"
+#include "triangle_area_normal.h"
+
+void per_face_normals(
+  const Eigen::MatrixXd & V,
+  const Eigen::MatrixXi & F,
+  Eigen::MatrixXd & N)
+{
+  ////////////////////////////////////////////////////////////////////////////
+  N.resize(F.rows(), 3);
+  #pragma omp parallel for
+  for (int f = 0; f < F.rows(); f++) {
+    const Eigen::RowVector3d n =
+        triangle_area_normal(V.row(F(f, 0)), V.row(F(f, 1)), V.row(F(f, 2)));
+    // Degenerate triangles get a zero normal
+    const double norm = n.norm();
+    N.row(f) = norm > 0 ? Eigen::RowVector3d(n / norm)
+                        : Eigen::RowVector3d::Zero();
+  }
+  ////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,35 @@
+#include "per_vertex_normals.h"
+#include "triangle_area_normal.h"
+#include "vertex_triangle_adjacency.h"
+
+void per_vertex_normals(
+  const Eigen::MatrixXd & V,
+  const Eigen::MatrixXi & F,
+  Eigen::MatrixXd & N)
+{
+  ////////////////////////////////////////////////////////////////////////////
+  // Area normals have length equal to the area, so summing them weights each
+  // face by its area
+  Eigen::MatrixXd A(F.rows(), 3);
+  #pragma omp parallel for
+  for (int f = 0; f < F.rows(); f++) {
+    A.row(f) =
+        triangle_area_normal(V.row(F(f, 0)), V.row(F(f, 1)), V.row(F(f, 2)));
+  }
+  Eigen::VectorXi VF, NI;
+  vertex_triangle_adjacency(F, V.rows(), VF, NI);
+  // Each vertex gathers from its own faces, so no two threads write the same
+  // row
+  N.resize(V.rows(), 3);
+  #pragma omp parallel for
+  for (int v = 0; v < V.rows(); v++) {
+    Eigen::RowVector3d n = Eigen::RowVector3d::Zero();
+    for (int k = NI(v); k < NI(v + 1); k++) {
+      n += A.row(VF(k));
+    }
+    const double norm = n.norm();
+    N.row(v) = norm > 0 ? Eigen::RowVector3d(n / norm)
+                        : Eigen::RowVector3d::Zero();
+  }
+  ////////////////////////////////////////////////////////////////////////////
+}
@@ -1,39 +1,69 @@
 #include "raycolor.h"
+#include "PixelSampler.h"
 #include "Ray.h"
 #include "first_hit.h"
+#include "profiler.h"
+#include "ray_stats.h"
 #include "blinn_phong_shading.h"
 #include "reflect.h"
 #include "viewing_ray.h"
+#include <limits>
 #include <Eigen/src/Core/Matrix.h>
 
 bool raycolor(const Ray &ray, const double min_t,
               const std::vector<std::shared_ptr<Object>> &objects,
               const std::vector<std::shared_ptr<Light>> &lights,
-              const int num_recursive_calls, Eigen::Vector3d &rgb) {
+              const int num_recursive_calls, Eigen::Vector3d &rgb,
+              const ObjectBVH *accel, int *hit_id_out, double *hit_t_out) {
   ////////////////////////////////////////////////////////////////////////////
   int hit_id;
   double t;
   Eigen::Vector3d n;
   rgb = Eigen::Vector3d(0, 0, 0);
-  if (first_hit(ray, min_t, objects, hit_id, t, n)) {
-    Eigen::Vector3d shade_color =
-        blinn_phong_shading(ray, hit_id, t, n, objects, lights);
-    rgb += shade_color;
-
-    if (num_recursive_calls < 3) {
-      Ray mirror_ray;
-      mirror_ray.direction = reflect(ray.direction, n);
-      mirror_ray.origin = ray.origin + t * ray.direction +
-                          1e-6 * mirror_ray.direction.normalized();
-
-      Eigen::Vector3d rgb_rec;
-      if (raycolor(mirror_ray, 1e-6, objects, lights, num_recursive_calls + 1,
-                   rgb_rec)) {
-        rgb += objects[hit_id]->material->km.cwiseProduct(rgb_rec);
-      }
-    }
+  bool hit;
+  {
+    RT_PROFILE_SCOPE(first_hit);
+    hit = first_hit(ray, min_t, objects, hit_id, t, n, accel);
+  }
+  if (hit_id_out) {
+    *hit_id_out = hit ? hit_id : -1;
+  }
+  if (hit_t_out) {
+    *hit_t_out = hit ? t : std::numeric_limits<double>::infinity();
+  }
+  if (hit) {
+    shade_hit(ray, hit_id, t, n, objects, lights, num_recursive_calls, rgb,
+              accel);
     return true;
   }
   return false;
   ////////////////////////////////////////////////////////////////////////////
 }
+
+void shade_hit(const Ray &ray, const int hit_id, const double t,
+               const Eigen::Vector3d &n,
+               const std::vector<std::shared_ptr<Object>> &objects,
+               const std::vector<std::shared_ptr<Light>> &lights,
+               const int num_recursive_calls, Eigen::Vector3d &rgb,
+               const ObjectBVH *accel) {
+  {
+    RT_PROFILE_SCOPE(shading);
+    rgb = blinn_phong_shading(ray, hit_id, t, n, objects, lights, accel);
+  }
+  this_thread_sampler().at_first_hit = false;
+
+  if (num_recursive_calls < 3) {
+    RT_PROFILE_SCOPE(reflection);
+    count_ray_stat(RayCounter::reflection_rays);
+    Ray mirror_ray;
+    mirror_ray.direction = reflect(ray.direction, n);
+    mirror_ray.origin = ray.origin + t * ray.direction +
+                        1e-6 * mirror_ray.direction.normalized();
+
+    Eigen::Vector3d rgb_rec;
+    if (raycolor(mirror_ray, 1e-6, objects, lights, num_recursive_calls + 1,
+                 rgb_rec, accel)) {
+      rgb += objects[hit_id]->material->km.cwiseProduct(rgb_rec);
+    }
+  }
+}
@@ -1,4 +1,6 @@
 #include "vertex_triangle_adjacency.h"
+#include <cstdint>
+#include <omp.h>
 
 void vertex_triangle_adjacency(
   const Eigen::MatrixXi & F,
@@ -17,3 +19,73 @@ void vertex_triangle_adjacency(
   ////////////////////////////////////////////////////////////////////////////
 }
 
+void vertex_triangle_adjacency(
+  const Eigen::MatrixXi & F,
+  const int num_vertices,
+  Eigen::VectorXi & VF,
+  Eigen::VectorXi & NI)
+{
+  NI.setZero(num_vertices + 1);
+  VF.resize(F.size());
+  // Faces are split into one contiguous block per thread, and each thread
+  // counts the corners of its block in its own per-vertex histogram. The
+  // count and fill passes then read every face once in total and never
+  // write a shared counter, at the cost of num_vertices ints per thread.
+  std::vector<std::vector<int> > count(omp_get_max_threads());
+  std::vector<int> thread_offset(omp_get_max_threads() + 1, 0);
+  #pragma omp parallel
+  {
+    const int num_threads = omp_get_num_threads();
+    const int thread = omp_get_thread_num();
+    const int f_begin =
+        static_cast<int>(int64_t(F.rows()) * thread / num_threads);
+    const int f_end =
+        static_cast<int>(int64_t(F.rows()) * (thread + 1) / num_threads);
+    std::vector<int> & local = count[thread];
+    local.assign(num_vertices, 0);
+    for (int f = f_begin; f < f_end; f++) {
+      for (int c = 0; c < F.cols(); c++) {
+        local[F(f, c)]++;
+      }
+    }
+    #pragma omp barrier
+    // Prefix sum over vertex ranges. Within a vertex the blocks are laid out
+    // in thread (hence face) order, and each histogram entry becomes that
+    // thread's first slot at the vertex.
+    const int v_begin =
+        static_cast<int>(int64_t(num_vertices) * thread / num_threads);
+    const int v_end =
+        static_cast<int>(int64_t(num_vertices) * (thread + 1) / num_threads);
+    int sum = 0;
+    for (int v = v_begin; v < v_end; v++) {
+      for (int t = 0; t < num_threads; t++) {
+        const int n = count[t][v];
+        count[t][v] = sum;
+        sum += n;
+      }
+      NI(v + 1) = sum;
+    }
+    thread_offset[thread + 1] = sum;
+    #pragma omp barrier
+    #pragma omp single
+    {
+      for (int t = 0; t < num_threads; t++) {
+        thread_offset[t + 1] += thread_offset[t];
+      }
+    }
+    const int base = thread_offset[thread];
+    for (int v = v_begin; v < v_end; v++) {
+      NI(v + 1) += base;
+      for (int t = 0; t < num_threads; t++) {
+        count[t][v] += base;
+      }
+    }
+    #pragma omp barrier
+    // Scatter each block through its own cursors
+    for (int f = f_begin; f < f_end; f++) {
+      for (int c = 0; c < F.cols(); c++) {
+        VF(local[F(f, c)]++) = f;
+      }
+    }
+  }
+}
@@ -1,7 +1,79 @@
 #include "write_obj.h"
+#include <algorithm>
 #include <fstream>
 #include <cassert>
+#include <charconv>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+namespace
+{
+  // Append a number in shortest round-trip form (no iostream formatting)
+  template <typename T>
+  void append_number(std::string & out, const T x)
+  {
+    char tmp[32];
+    const std::to_chars_result r = std::to_chars(tmp, tmp + sizeof(tmp), x);
+    out.append(tmp, r.ptr);
+  }
+
+  // Format rows [0,rows) with format_row(i, out) and write them in order.
+  // Chunks of rows are formatted in parallel one batch at a time, so the
+  // buffered text stays bounded however large the mesh is.
+  template <typename FormatRow>
+  bool write_rows(
+    std::ofstream & file,
+    const int rows,
+    const FormatRow & format_row)
+  {
+    const int chunk_rows = 1 << 14;
+    const int batch_chunks = 4 * omp_get_max_threads();
+    std::vector<std::string> chunks(batch_chunks);
+    for(int batch = 0; batch < rows; batch += chunk_rows * batch_chunks)
+    {
+      #pragma omp parallel for schedule(dynamic)
+      for(int c = 0; c < batch_chunks; c++)
+      {
+        std::string & out = chunks[c];
+        out.clear();
+        const int begin = batch + c * chunk_rows;
+        const int end = std::min(rows, begin + chunk_rows);
+        for(int i = begin; i < end; i++)
+        {
+          format_row(i, out);
+        }
+      }
+      for(const std::string & out : chunks)
+      {
+        file.write(out.data(), out.size());
+      }
+      if(!file)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool write_vectors(
+    std::ofstream & file,
+    const char * tag,
+    const Eigen::MatrixXd & X)
+  {
+    return write_rows(file, X.rows(), [&](const int i, std::string & out)
+    {
+      out += tag;
+      for(int j = 0; j < X.cols(); j++)
+      {
+        out += ' ';
+        append_number(out, X(i,j));
+      }
+      out += '\n';
+    });
+  }
+}
 
 bool write_obj(
   const std::string & filename,
@@ -15,43 +87,39 @@ bool write_obj(
   assert((F.size() == 0 || F.cols() == 3 || F.cols() == 4) && "F must have 3 or 4 columns");
   ////////////////////////////////////////////////////////////////////////////
   // Add your code here:
-  std::ofstream file(filename);
+  std::ofstream file(filename, std::ios::binary);
   if (!file.is_open()) {
     return false;
   }
+  // UV and normal indices are optional; only emit the ones that match F
+  const bool has_uv = UF.rows() == F.rows() && UF.cols() == F.cols() &&
+                      UF.size() > 0;
+  const bool has_normals = NF.rows() == F.rows() && NF.cols() == F.cols() &&
+                           NF.size() > 0;
 
-  // V
-  for (int i=0; i<V.rows(); i++){
-    file << "v";
-    for (int j=0; j<V.cols(); j++) {
-      file << " " << V(i,j);
-    }
-    file << "\n";
-  }
-  // UV
-  for (int i=0; i<UV.rows(); i++){
-    file << "vt";
-    for (int j=0; j<UV.cols(); j++) {
-      file << " " << UV(i,j);
-    }
-    file << "\n";
-  }
-  // NV
-  for (int i=0; i<NV.rows(); i++){
-    file << "vn";
-    for (int j=0; j<NV.cols(); j++) {
-      file << " " << NV(i,j);
-    }
-    file << "\n";
+  if (!write_vectors(file, "v", V) ||
+      !write_vectors(file, "vt", UV) ||
+      !write_vectors(file, "vn", NV)) {
+    return false;
   }
-  // F
-  for (int i=0; i<F.rows(); i++){
-    file << "f ";
-    for (int j=0; j<F.cols(); j++) {
-      file << F(i,j)+1 << "/" << UF(i,j)+1 << "/" << NF(i,j)+1 << " ";
+  // F as v, v/vt, v//vn or v/vt/vn
+  return write_rows(file, F.rows(), [&](const int i, std::string &out) {
+    out += 'f';
+    for (int j = 0; j < F.cols(); j++) {
+      out += ' ';
+      append_number(out, F(i,j)+1);
+      if (has_uv || has_normals) {
+        out += '/';
+      }
+      if (has_uv) {
+        append_number(out, UF(i,j)+1);
+      }
+      if (has_normals) {
+        out += '/';
+        append_number(out, NF(i,j)+1);
+      }
     }
-    file << "\n";
-  }
-  return true;
+    out += '\n';
+  });
   ////////////////////////////////////////////////////////////////////////////
 }
@@ -1,8 +1,10 @@
 #include "write_ppm.h"
+#include <algorithm>
 #include <fstream>
 #include <cassert>
 #include <iostream>
 #include <ostream>
+#include <string>
 
 bool write_ppm(const std::string &filename,
                const std::vector<unsigned char> &data, const int width,
@@ -11,22 +13,28 @@ bool write_ppm(const std::string &filename,
          ".ppm only supports RGB or grayscale images");
   ////////////////////////////////////////////////////////////////////////////
   // Replace with your code here:
-  std::ofstream file(filename);
+  // Binary P6: header plus one bulk write of the whole raster
+  std::ofstream file(filename, std::ios::binary);
   if (!file.is_open()) {
     return false;
   }
-  file << "P3\n" << width << " " << height << "\n255\n";
+  const std::string header = "P6\n" + std::to_string(width) + " " +
+                             std::to_string(height) + "\n255\n";
+  const size_t num_pixels = static_cast<size_t>(width) * height;
+  std::vector<char> buffer(header.size() + 3 * num_pixels);
+  std::copy(header.begin(), header.end(), buffer.begin());
+  char *pixels = buffer.data() + header.size();
   if (num_channels == 3) {
-    for (int i = 0; i < 3 * width * height; i += 3) {
-      file << (int)data[i] << " " << (int)data[i + 1] << " " << (int)data[i + 2]
-           << "\n";
-    }
+    std::copy(data.begin(), data.begin() + 3 * num_pixels, pixels);
   } else {
-    for (int i = 0; i < width * height; i++) {
-      unsigned char color = data[i];
-      file << (int)color << " " << (int)color << " " << (int)color << "\n";
+    for (size_t i = 0; i < num_pixels; i++) {
+      pixels[3 * i + 0] = pixels[3 * i + 1] = pixels[3 * i + 2] = data[i];
     }
   }
+  file.write(buffer.data(), buffer.size());
+  if (!file) {
+    return false;
+  }
   return true;
   ////////////////////////////////////////////////////////////////////////////
 }
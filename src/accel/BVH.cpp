@@ -0,0 +1,346 @@
+#include "BVH.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+
+const char * bvh_build_name(const BVHBuild method)
+{
+  switch(method)
+  {
+    case BVHBuild::median: return "median";
+    case BVHBuild::sah: return "sah";
+    case BVHBuild::linear: return "linear";
+  }
+  return "";
+}
+
+bool parse_bvh_build(const std::string & name, BVHBuild & method)
+{
+  for(const BVHBuild m : {BVHBuild::median,BVHBuild::sah,BVHBuild::linear})
+  {
+    if(name == bvh_build_name(m))
+    {
+      method = m;
+      return true;
+    }
+  }
+  return false;
+}
+
+namespace
+{
+  // Ranges smaller than this are built by the task that split them off
+  const int task_size = 4096;
+  // Below this depth every builder still leaves room for a median split of
+  // 2^31 primitives within the 64-entry traversal stacks
+  const int max_sah_depth = 32;
+  const int num_bins = 16;
+
+  // Spread the low 10 bits of x out to every third bit
+  uint32_t expand_bits(uint32_t x)
+  {
+    x = (x | (x << 16)) & 0x030000FFu;
+    x = (x | (x << 8)) & 0x0300F00Fu;
+    x = (x | (x << 4)) & 0x030C30C3u;
+    x = (x | (x << 2)) & 0x09249249u;
+    return x;
+  }
+
+  // Top-down builder shared by all methods. Each node covers a range of
+  // indices and is split by reordering that range; children are allocated
+  // in pairs after their parent, so refit's reverse sweep stays valid.
+  class Builder
+  {
+    public:
+      Builder(
+        const std::vector<BoundingBox> & a_boxes,
+        const int a_leaf_size,
+        const BVHBuild a_method,
+        std::vector<BVHNode> & a_nodes,
+        std::vector<int> & a_indices)
+        : boxes(a_boxes), leaf_size(std::max(a_leaf_size,1)), method(a_method),
+          nodes(a_nodes), indices(a_indices) {}
+      void build()
+      {
+        const int n = static_cast<int>(boxes.size());
+        centers.resize(n);
+        #pragma omp parallel for if(n > task_size)
+        for(int i = 0;i<n;i++)
+        {
+          centers[i] = boxes[i].center();
+        }
+        if(method == BVHBuild::linear)
+        {
+          sort_by_morton_code();
+        }
+        // A binary tree with at least one primitive per leaf has < 2n nodes
+        nodes.resize(2*n);
+        next_node = 1;
+        #pragma omp parallel if(n > task_size)
+        #pragma omp single
+        build_node(0,0,n,0);
+        nodes.resize(next_node);
+      }
+    private:
+      // Sort indices by the Morton code of their centers (ties broken by
+      // index so that codes are unique as a whole)
+      void sort_by_morton_code()
+      {
+        const int n = static_cast<int>(boxes.size());
+        BoundingBox centroid_box;
+        for(const Eigen::Vector3d & c : centers)
+        {
+          centroid_box.extend(c);
+        }
+        const Eigen::Vector3d extent =
+          (centroid_box.max_corner-centroid_box.min_corner).cwiseMax(1e-300);
+        std::vector<uint64_t> keys(n);
+        #pragma omp parallel for if(n > task_size)
+        for(int i = 0;i<n;i++)
+        {
+          const Eigen::Vector3d u =
+            (centers[i]-centroid_box.min_corner).cwiseQuotient(extent);
+          uint32_t code = 0;
+          for(int a = 0;a<3;a++)
+          {
+            const uint32_t q = static_cast<uint32_t>(
+              std::min(std::max(u(a)*1024.0,0.0),1023.0));
+            code |= expand_bits(q) << (2-a);
+          }
+          keys[i] = (static_cast<uint64_t>(code) << 32) | static_cast<uint32_t>(i);
+        }
+        std::sort(keys.begin(),keys.end());
+        codes.resize(n);
+        for(int i = 0;i<n;i++)
+        {
+          indices[i] = static_cast<int>(keys[i] & 0xFFFFFFFFu);
+          codes[i] = static_cast<uint32_t>(keys[i] >> 32);
+        }
+      }
+      // Split of indices[begin,end) at the highest bit where the (sorted)
+      // Morton codes differ, i.e., the radix tree over the codes
+      int linear_split(const int begin, const int end) const
+      {
+        const uint32_t differ = codes[begin]^codes[end-1];
+        if(differ == 0)
+        {
+          return begin + (end-begin)/2;
+        }
+        int bit = 31;
+        while(!(differ & (1u << bit))) bit--;
+        return static_cast<int>(std::partition_point(
+          codes.begin()+begin,codes.begin()+end,
+          [&](const uint32_t code){ return !(code & (1u << bit)); })-codes.begin());
+      }
+      int median_split(
+        const int begin, const int end, const BoundingBox & centroid_box)
+      {
+        int axis;
+        (centroid_box.max_corner-centroid_box.min_corner).maxCoeff(&axis);
+        const int mid = begin + (end-begin)/2;
+        std::nth_element(
+          indices.begin()+begin,indices.begin()+mid,indices.begin()+end,
+          [&](const int a, const int b){ return centers[a](axis) < centers[b](axis); });
+        return mid;
+      }
+      // Binned surface area heuristic over all three axes
+      int sah_split(
+        const int begin, const int end, const BoundingBox & centroid_box)
+      {
+        struct Bin { BoundingBox box; int count = 0; };
+        double best_cost = std::numeric_limits<double>::infinity();
+        int best_axis = -1;
+        int best_bin = 0;
+        for(int axis = 0;axis<3;axis++)
+        {
+          const double lo = centroid_box.min_corner(axis);
+          const double extent = centroid_box.max_corner(axis)-lo;
+          if(!(extent > 0))
+          {
+            continue;
+          }
+          const double scale = num_bins/extent;
+          Bin bins[num_bins];
+          for(int i = begin;i<end;i++)
+          {
+            const int b = std::min(
+              static_cast<int>((centers[indices[i]](axis)-lo)*scale),num_bins-1);
+            bins[b].box.extend(boxes[indices[i]]);
+            bins[b].count++;
+          }
+          // Cost of splitting after bin b: area*count on either side
+          double right_cost[num_bins];
+          BoundingBox right;
+          int right_count = 0;
+          for(int b = num_bins-1;b>0;b--)
+          {
+            right.extend(bins[b].box);
+            right_count += bins[b].count;
+            right_cost[b-1] = right.surface_area()*right_count;
+          }
+          BoundingBox left;
+          int left_count = 0;
+          for(int b = 0;b<num_bins-1;b++)
+          {
+            left.extend(bins[b].box);
+            left_count += bins[b].count;
+            if(left_count == 0 || left_count == end-begin)
+            {
+              continue;
+            }
+            const double cost = left.surface_area()*left_count + right_cost[b];
+            if(cost < best_cost)
+            {
+              best_cost = cost;
+              best_axis = axis;
+              best_bin = b;
+            }
+          }
+        }
+        if(best_axis < 0)
+        {
+          return median_split(begin,end,centroid_box);
+        }
+        const double lo = centroid_box.min_corner(best_axis);
+        const double scale =
+          num_bins/(centroid_box.max_corner(best_axis)-lo);
+        return static_cast<int>(std::partition(
+          indices.begin()+begin,indices.begin()+end,
+          [&](const int i)
+          {
+            const int b = std::min(
+              static_cast<int>((centers[i](best_axis)-lo)*scale),num_bins-1);
+            return b <= best_bin;
+          })-indices.begin());
+      }
+      // Fill in node (already allocated) covering indices[begin,end)
+      void build_node(const int node_id, const int begin, const int end, const int depth)
+      {
+        BVHNode & node = nodes[node_id];
+        const int count = end-begin;
+        if(count <= leaf_size)
+        {
+          node.first = begin;
+          node.count = count;
+          finish_leaf(node);
+          return;
+        }
+        int mid;
+        if(method == BVHBuild::linear)
+        {
+          // The box is the union of the children's, set once both
+          // are built (after the taskwait below)
+          mid = linear_split(begin,end);
+        }else
+        {
+          BoundingBox centroid_box;
+          for(int i = begin;i<end;i++)
+          {
+            node.box.extend(boxes[indices[i]]);
+            centroid_box.extend(centers[indices[i]]);
+          }
+          if(!((centroid_box.max_corner-centroid_box.min_corner).maxCoeff() > 0))
+          {
+            // All centroids coincide: no split separates them, but leaves
+            // must not exceed leaf_size
+            mid = begin + count/2;
+          }else if(method == BVHBuild::sah && depth < max_sah_depth)
+          {
+            mid = sah_split(begin,end,centroid_box);
+          }else
+          {
+            mid = median_split(begin,end,centroid_box);
+          }
+        }
+        const int left = next_node.fetch_add(2);
+        node.first = left;
+        node.count = 0;
+        #pragma omp task if(mid-begin > task_size)
+        build_node(left,begin,mid,depth+1);
+        build_node(left+1,mid,end,depth+1);
+        #pragma omp taskwait
+        if(method == BVHBuild::linear)
+        {
+          nodes[node_id].box = nodes[left].box;
+          nodes[node_id].box.extend(nodes[left+1].box);
+        }
+      }
+      void finish_leaf(BVHNode & node) const
+      {
+        node.box = BoundingBox();
+        for(int i = node.first;i<node.first+node.count;i++)
+        {
+          node.box.extend(boxes[indices[i]]);
+        }
+      }
+      const std::vector<BoundingBox> & boxes;
+      const int leaf_size;
+      const BVHBuild method;
+      std::vector<BVHNode> & nodes;
+      std::vector<int> & indices;
+      std::vector<Eigen::Vector3d> centers;
+      // Sorted Morton codes (linear builds only), aligned with indices
+      std::vector<uint32_t> codes;
+      std::atomic<int> next_node{1};
+  };
+}
+
+void BVH::build(
+  const std::vector<BoundingBox> & boxes,
+  const int leaf_size,
+  const BVHBuild method)
+{
+  nodes.clear();
+  indices.resize(boxes.size());
+  std::iota(indices.begin(),indices.end(),0);
+  if(boxes.empty())
+  {
+    return;
+  }
+  Builder(boxes,leaf_size,method,nodes,indices).build();
+}
+
+void BVH::refit(const std::vector<BoundingBox> & boxes)
+{
+  // Children are always stored after their parent, so a reverse sweep visits
+  // both children before the parent.
+  for(int i = static_cast<int>(nodes.size())-1;i>=0;i--)
+  {
+    BVHNode & node = nodes[i];
+    BoundingBox box;
+    if(node.is_leaf())
+    {
+      for(int j = node.first;j<node.first+node.count;j++)
+      {
+        box.extend(boxes[indices[j]]);
+      }
+    }else
+    {
+      box.extend(nodes[node.first].box);
+      box.extend(nodes[node.first+1].box);
+    }
+    node.box = box;
+  }
+}
+
+double BVH::sah_cost() const
+{
+  if(nodes.empty())
+  {
+    return 0;
+  }
+  const double root_area = nodes[0].box.surface_area();
+  if(root_area <= 0)
+  {
+    return static_cast<double>(indices.size());
+  }
+  double cost = 0;
+  for(const BVHNode & node : nodes)
+  {
+    const double p = node.box.surface_area()/root_area;
+    cost += p*(node.is_leaf() ? node.count : 1);
+  }
+  return cost;
+}
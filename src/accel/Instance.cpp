@@ -0,0 +1,70 @@
+#include "Instance.h"
+#include "Ray.h"
+
+Instance::Instance(
+  const std::shared_ptr<const PackedMesh> & a_mesh,
+  const Eigen::Affine3d & a_transform)
+  : mesh(a_mesh)
+{
+  set_transform(a_transform);
+}
+
+void Instance::set_transform(const Eigen::Affine3d & a_transform)
+{
+  object_to_world = a_transform;
+  world_to_object = a_transform.inverse();
+}
+
+Ray Instance::to_object(const Ray & ray) const
+{
+  Ray local;
+  local.origin = world_to_object * ray.origin;
+  local.direction = world_to_object.linear() * ray.direction;
+  return local;
+}
+
+bool Instance::closest_hit(
+  const Ray & ray,
+  const double min_t,
+  const double max_t,
+  Hit & hit) const
+{
+  return mesh && mesh->closest_hit(to_object(ray),min_t,max_t,hit);
+}
+
+Eigen::Vector3d Instance::surface_normal(const Ray & ray, const Hit & hit) const
+{
+  const Eigen::Vector3d local_n = mesh->surface_normal(to_object(ray),hit);
+  // Normals transform by the inverse transpose. This keeps the sign of
+  // n.dot(direction), so n still faces the ray.
+  return (world_to_object.linear().transpose() * local_n).normalized();
+}
+
+BoundingBox Instance::bounding_box() const
+{
+  BoundingBox box;
+  if(!mesh || mesh->bvh.empty())
+  {
+    return box;
+  }
+  const BoundingBox local = mesh->bounding_box();
+  for(int c = 0;c<8;c++)
+  {
+    const Eigen::Vector3d corner(
+      (c&1) ? local.max_corner.x() : local.min_corner.x(),
+      (c&2) ? local.max_corner.y() : local.min_corner.y(),
+      (c&4) ? local.max_corner.z() : local.min_corner.z());
+    box.extend(object_to_world * corner);
+  }
+  return box;
+}
+
+bool Instance::intersects_beam(const Beam & beam) const
+{
+  return mesh && mesh->intersects_beam(beam.transformed(world_to_object));
+}
+
+bool Instance::covers_beam(const Beam & beam) const
+{
+  return mesh && mesh->covers_beam(beam.transformed(world_to_object));
+}
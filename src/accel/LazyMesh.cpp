@@ -0,0 +1,98 @@
+#include "LazyMesh.h"
+#include "Ray.h"
+#include <algorithm>
+#include <limits>
+
+LazyMesh::LazyMesh(
+  const std::shared_ptr<GeometryPager> & a_pager,
+  const int a_handle,
+  const BoundingBox & a_bounds)
+  : pager(a_pager), handle(a_handle), bounds(a_bounds)
+{
+}
+
+bool LazyMesh::closest_hit(
+  const Ray & ray,
+  const double min_t,
+  const double max_t,
+  Hit & hit) const
+{
+  if(const PackedMesh * mesh = pager->acquire(handle))
+  {
+    if(!mesh->closest_hit(ray,min_t,max_t,hit))
+    {
+      return false;
+    }
+    hit.mesh = mesh;
+    return true;
+  }
+  // Placeholder: the box face the ray enters through (or leaves through,
+  // from inside)
+  const Eigen::Vector3d inv_direction = ray.direction.cwiseInverse();
+  double t_enter;
+  if(!ray_intersect_box(ray.origin,inv_direction,bounds,min_t,max_t,t_enter))
+  {
+    return false;
+  }
+  int axis = -1;
+  for(int a = 0;a<3;a++)
+  {
+    const double ta = (bounds.min_corner(a)-ray.origin(a))*inv_direction(a);
+    const double tb = (bounds.max_corner(a)-ray.origin(a))*inv_direction(a);
+    if(std::min(ta,tb) == t_enter)
+    {
+      axis = a;
+    }
+  }
+  if(axis < 0)
+  {
+    // Starts inside the box: exit through the nearest far slab
+    double t_exit = std::numeric_limits<double>::infinity();
+    for(int a = 0;a<3;a++)
+    {
+      const double ta = (bounds.min_corner(a)-ray.origin(a))*inv_direction(a);
+      const double tb = (bounds.max_corner(a)-ray.origin(a))*inv_direction(a);
+      if(std::max(ta,tb) < t_exit)
+      {
+        t_exit = std::max(ta,tb);
+        axis = a;
+      }
+    }
+    t_enter = t_exit;
+  }
+  if(axis < 0 || !(t_enter > min_t) || t_enter >= max_t)
+  {
+    return false;
+  }
+  hit.t = t_enter;
+  hit.primitive = -1-axis;
+  hit.mesh = nullptr;
+  return true;
+}
+
+Eigen::Vector3d LazyMesh::surface_normal(const Ray & ray, const Hit & hit) const
+{
+  if(hit.mesh)
+  {
+    return hit.mesh->surface_normal(ray,hit);
+  }
+  const int axis = -1-hit.primitive;
+  Eigen::Vector3d n = Eigen::Vector3d::Zero();
+  n(axis) = ray.direction(axis) > 0 ? -1.0 : 1.0;
+  return n;
+}
+
+bool LazyMesh::intersects_beam(const Beam & beam) const
+{
+  if(const PackedMesh * mesh = pager->resident_mesh(handle))
+  {
+    return mesh->intersects_beam(beam);
+  }
+  return Object::intersects_beam(beam);
+}
+
+bool LazyMesh::covers_beam(const Beam & beam) const
+{
+  const PackedMesh * mesh = pager->resident_mesh(handle);
+  return mesh && mesh->covers_beam(beam);
+}
@@ -0,0 +1,89 @@
+#include "ObjectBVH.h"
+#include "Plane.h"
+#include "Sphere.h"
+
+// Sort objects into spheres, planes, other bounded objects (with their
+// boxes) and other unbounded objects
+static void classify_objects(
+  const std::vector<std::shared_ptr<Object> > & objects,
+  std::vector<int> & sphere_ids,
+  std::vector<int> & plane_ids,
+  std::vector<int> & bounded_ids,
+  std::vector<BoundingBox> & bounded_boxes,
+  std::vector<int> & unbounded_ids)
+{
+  for(int i = 0;i<static_cast<int>(objects.size());i++)
+  {
+    const Object * object = objects[i].get();
+    if(dynamic_cast<const Sphere *>(object))
+    {
+      sphere_ids.push_back(i);
+      continue;
+    }
+    if(dynamic_cast<const Plane *>(object))
+    {
+      plane_ids.push_back(i);
+      continue;
+    }
+    const BoundingBox box = object->bounding_box();
+    if(box.is_finite())
+    {
+      bounded_boxes.push_back(box);
+      bounded_ids.push_back(i);
+    }else if(!box.empty())
+    {
+      unbounded_ids.push_back(i);
+    }
+  }
+}
+
+void ObjectBVH::build(const std::vector<std::shared_ptr<Object> > & objects)
+{
+  std::vector<int> sphere_ids, plane_ids, ids;
+  std::vector<BoundingBox> boxes;
+  unbounded.clear();
+  classify_objects(objects,sphere_ids,plane_ids,ids,boxes,unbounded);
+  spheres.build(objects,sphere_ids);
+  planes.build(objects,plane_ids);
+  // Objects are visited by BVH leaves through indices; map those back from
+  // positions in boxes to positions in objects.
+  bvh.build(boxes,1);
+  for(int & index : bvh.indices)
+  {
+    index = ids[index];
+  }
+  built_cost = bvh.sah_cost();
+}
+
+bool ObjectBVH::update(
+  const std::vector<std::shared_ptr<Object> > & objects,
+  const double rebuild_factor)
+{
+  std::vector<int> sphere_ids, plane_ids, ids, unbounded_ids;
+  std::vector<BoundingBox> bounded_boxes;
+  classify_objects(
+    objects,sphere_ids,plane_ids,ids,bounded_boxes,unbounded_ids);
+  bool same_split =
+    sphere_ids.size() == spheres.size() &&
+    plane_ids.size() == planes.ids.size() &&
+    ids.size() == bvh.indices.size();
+  std::vector<BoundingBox> boxes(objects.size());
+  for(size_t k = 0;k<ids.size();k++)
+  {
+    boxes[ids[k]] = bounded_boxes[k];
+  }
+  for(int i = 0;same_split && i<static_cast<int>(bvh.indices.size());i++)
+  {
+    same_split = boxes[bvh.indices[i]].is_finite();
+  }
+  if(same_split)
+  {
+    bvh.refit(boxes);
+    if(bvh.sah_cost() <= rebuild_factor*built_cost)
+    {
+      return false;
+    }
+  }
+  build(objects);
+  return true;
+}
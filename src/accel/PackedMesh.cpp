@@ -0,0 +1,210 @@
+#include "PackedMesh.h"
+#include "per_corner_normals.h"
+#include "per_vertex_normals.h"
+#include "ray_stats.h"
+#include <Eigen/Geometry>
+#include <vector>
+
+// Shading normals this close to the face normal count as flat
+static const double flat_cos = 1.0-1e-6;
+
+const char * mesh_normals_name(const MeshNormals normals)
+{
+  switch(normals)
+  {
+    case MeshNormals::flat: return "flat";
+    case MeshNormals::per_vertex: return "per_vertex";
+    case MeshNormals::per_corner: return "per_corner";
+  }
+  return "";
+}
+
+bool parse_mesh_normals(const std::string & name, MeshNormals & normals)
+{
+  for(const MeshNormals n :
+    {MeshNormals::flat,MeshNormals::per_vertex,MeshNormals::per_corner})
+  {
+    if(name == mesh_normals_name(n))
+    {
+      normals = n;
+      return true;
+    }
+  }
+  return false;
+}
+
+static std::vector<BoundingBox> triangle_boxes(const PackedMesh & mesh)
+{
+  std::vector<BoundingBox> boxes(mesh.F.rows());
+  for(int f = 0;f<mesh.F.rows();f++)
+  {
+    for(int c = 0;c<3;c++)
+    {
+      boxes[f].extend(
+        Eigen::Vector3d(mesh.V.row(mesh.F(f,c)).cast<double>().transpose()));
+    }
+  }
+  return boxes;
+}
+
+void PackedMesh::build_bvh(const BVHBuild method)
+{
+  bvh.build(triangle_boxes(*this),4,method);
+}
+
+void PackedMesh::refit_bvh()
+{
+  bvh.refit(triangle_boxes(*this));
+}
+
+void PackedMesh::compute_normals(
+  const MeshNormals kind, const double corner_threshold)
+{
+  normals = kind;
+  if(kind == MeshNormals::flat)
+  {
+    N.resize(0,3);
+    return;
+  }
+  const Eigen::MatrixXd dV = V.cast<double>();
+  const Eigen::MatrixXi dF = F;
+  Eigen::MatrixXd dN;
+  if(kind == MeshNormals::per_vertex)
+  {
+    per_vertex_normals(dV,dF,dN);
+  }else
+  {
+    per_corner_normals(dV,dF,corner_threshold,dN);
+  }
+  N = dN.cast<float>();
+}
+
+bool PackedMesh::closest_hit(
+  const Ray & ray,
+  const double min_t,
+  const double max_t,
+  Hit & hit) const
+{
+  double t = max_t;
+  int hit_f = -1;
+  double hit_u = 0, hit_v = 0;
+  uint64_t tests = 0;
+  // Moller-Trumbore
+  bvh.intersect(ray,min_t,t,[&](const int f, double & max_t)->bool
+  {
+    tests++;
+    const Eigen::Vector3d a = V.row(F(f,0)).cast<double>();
+    const Eigen::Vector3d e1 = V.row(F(f,1)).cast<double>().transpose() - a;
+    const Eigen::Vector3d e2 = V.row(F(f,2)).cast<double>().transpose() - a;
+    const Eigen::Vector3d p = ray.direction.cross(e2);
+    const double det = e1.dot(p);
+    if(det == 0) return false;
+    const double inv_det = 1.0/det;
+    const Eigen::Vector3d s = ray.origin - a;
+    const double u = s.dot(p)*inv_det;
+    if(u < 0 || u > 1) return false;
+    const Eigen::Vector3d q = s.cross(e1);
+    const double v = ray.direction.dot(q)*inv_det;
+    if(v < 0 || u + v > 1) return false;
+    const double s_t = e2.dot(q)*inv_det;
+    if(s_t <= min_t || s_t >= max_t) return false;
+    max_t = s_t;
+    hit_f = f;
+    hit_u = u;
+    hit_v = v;
+    return true;
+  });
+  count_ray_stat(RayCounter::triangle_tests,tests);
+  if(hit_f < 0)
+  {
+    return false;
+  }
+  hit.t = t;
+  hit.primitive = hit_f;
+  hit.u = hit_u;
+  hit.v = hit_v;
+  return true;
+}
+
+Eigen::Vector3d PackedMesh::surface_normal(const Ray & ray, const Hit & hit) const
+{
+  const int f = hit.primitive;
+  const Eigen::Vector3d a = corner(f,0);
+  Eigen::Vector3d n = (corner(f,1)-a).cross(corner(f,2)-a).normalized();
+  // Which side of the face the ray sees
+  const double side = n.dot(ray.direction) > 0 ? -1.0 : 1.0;
+  if(normals != MeshNormals::flat)
+  {
+    Eigen::Vector3d s = (
+      (1.0-hit.u-hit.v)*corner_normal(f,0) +
+      hit.u*corner_normal(f,1) +
+      hit.v*corner_normal(f,2)).normalized();
+    // Faces wound against their neighbours still shade on the right side
+    if(s.dot(n) < 0)
+    {
+      s = -s;
+    }
+    // Nearly flat shading snaps to the face normal (see flat_shaded); a
+    // degenerate s (zero) keeps it too
+    if(s.dot(n) > 0 && s.dot(n) < flat_cos)
+    {
+      n = s;
+    }
+  }
+  return side*n;
+}
+
+bool PackedMesh::flat_shaded(const int f) const
+{
+  if(normals == MeshNormals::flat)
+  {
+    return true;
+  }
+  const Eigen::Vector3d a = corner(f,0);
+  const Eigen::Vector3d n = (corner(f,1)-a).cross(corner(f,2)-a).normalized();
+  // All corners along n, or all against it (surface_normal flips those)
+  const double side = corner_normal(f,0).dot(n) < 0 ? -1.0 : 1.0;
+  for(int c = 0;c<3;c++)
+  {
+    if(side*corner_normal(f,c).dot(n) < flat_cos)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PackedMesh::intersects_beam(const Beam & beam) const
+{
+  return bvh.any_of(
+    [&](const BoundingBox & box){ return !beam.outside(box); },
+    [&](const int f)
+    {
+      return !beam.outside(corner(f,0),corner(f,1),corner(f,2));
+    });
+}
+
+bool PackedMesh::covers_beam(const Beam & beam) const
+{
+  // Only boxes around the whole footprint can hold a covering triangle
+  BoundingBox footprint;
+  for(const Eigen::Vector3d & p : beam.footprint)
+  {
+    footprint.extend(p);
+  }
+  const Eigen::Array3d slack = Eigen::Array3d::Constant(beam.tolerance);
+  return bvh.any_of(
+    [&](const BoundingBox & box)
+    {
+      return
+        (box.min_corner.array() <= footprint.min_corner.array()+slack).all() &&
+        (box.max_corner.array() >= footprint.max_corner.array()-slack).all();
+    },
+    [&](const int f)
+    {
+      // A shading normal that varies across the footprint would not match
+      // the one normal the pre-pass gives the whole block
+      return flat_shaded(f) &&
+        beam.covered_by(corner(f,0),corner(f,1),corner(f,2));
+    });
+}
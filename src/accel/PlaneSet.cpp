@@ -0,0 +1,26 @@
+#include "PlaneSet.h"
+#include "Plane.h"
+
+void PlaneSet::build(
+  const std::vector<std::shared_ptr<Object> > & objects,
+  const std::vector<int> & plane_ids)
+{
+  nx.clear();
+  ny.clear();
+  nz.clear();
+  offset.clear();
+  ids = plane_ids;
+  for(const int id : plane_ids)
+  {
+    const Plane & plane = static_cast<const Plane &>(*objects[id]);
+    nx.push_back(plane.normal.x());
+    ny.push_back(plane.normal.y());
+    nz.push_back(plane.normal.z());
+    offset.push_back(plane.normal.dot(plane.point));
+  }
+  // Padding read by the last pair when there is an odd number of planes
+  nx.push_back(0);
+  ny.push_back(0);
+  nz.push_back(0);
+  offset.push_back(0);
+}
@@ -0,0 +1,38 @@
+#include "SphereSet.h"
+#include "Sphere.h"
+
+void SphereSet::build(
+  const std::vector<std::shared_ptr<Object> > & objects,
+  const std::vector<int> & sphere_ids)
+{
+  std::vector<BoundingBox> boxes(sphere_ids.size());
+  for(size_t s = 0;s<sphere_ids.size();s++)
+  {
+    boxes[s] = objects[sphere_ids[s]]->bounding_box();
+  }
+  bvh.build(boxes,lanes);
+  // Lay the spheres out in leaf order so that every leaf is a contiguous
+  // batch, then let the leaves index the arrays directly
+  const size_t n = sphere_ids.size();
+  cx.resize(n);
+  cy.resize(n);
+  cz.resize(n);
+  radius.resize(n);
+  ids.resize(n);
+  for(size_t i = 0;i<n;i++)
+  {
+    const int id = sphere_ids[bvh.indices[i]];
+    const Sphere & sphere = static_cast<const Sphere &>(*objects[id]);
+    cx[i] = sphere.center.x();
+    cy[i] = sphere.center.y();
+    cz[i] = sphere.center.z();
+    radius[i] = sphere.radius;
+    ids[i] = id;
+    bvh.indices[i] = static_cast<int>(i);
+  }
+  // Padding read by the last pair of an odd-sized final leaf
+  cx.push_back(0);
+  cy.push_back(0);
+  cz.push_back(0);
+  radius.push_back(0);
+}
@@ -0,0 +1,208 @@
+#include "WideBVH.h"
+#include <algorithm>
+#include <cmath>
+
+void WideBVH::build(
+  const std::vector<BoundingBox> & boxes,
+  const int leaf_size,
+  const BVHBuild method)
+{
+  const int width = WideBVHNode::width;
+  nodes.clear();
+  BVH binary;
+  binary.build(boxes,std::min(leaf_size,255),method);
+  indices = std::move(binary.indices);
+  if(binary.empty())
+  {
+    root_box = BoundingBox();
+    return;
+  }
+  // Collapse: each wide node takes the binary node's children and keeps
+  // opening its largest interior child until it has width children.
+  // Children are appended after their parent, as refit expects.
+  nodes.emplace_back();
+  std::vector<int> sources(1,0);
+  for(size_t w = 0;w<sources.size();w++)
+  {
+    const BVHNode & source = binary.nodes[sources[w]];
+    int children[width];
+    int num_children = 0;
+    if(source.is_leaf())
+    {
+      // Only a root can be a leaf
+      children[num_children++] = sources[w];
+    }else
+    {
+      children[num_children++] = source.first;
+      children[num_children++] = source.first+1;
+    }
+    while(num_children < width)
+    {
+      int open = -1;
+      double largest = -1;
+      for(int c = 0;c<num_children;c++)
+      {
+        const BVHNode & child = binary.nodes[children[c]];
+        if(!child.is_leaf() && child.box.surface_area() > largest)
+        {
+          largest = child.box.surface_area();
+          open = c;
+        }
+      }
+      if(open < 0)
+      {
+        break;
+      }
+      const int first = binary.nodes[children[open]].first;
+      children[open] = first;
+      children[num_children++] = first+1;
+    }
+    for(int k = 0;k<width;k++)
+    {
+      WideBVHNode & node = nodes[w];
+      if(k >= num_children)
+      {
+        node.child[k] = -1;
+        node.count[k] = 0;
+        continue;
+      }
+      const BVHNode & child = binary.nodes[children[k]];
+      if(child.is_leaf())
+      {
+        node.child[k] = child.first;
+        node.count[k] = static_cast<uint8_t>(child.count);
+      }else
+      {
+        node.child[k] = static_cast<int>(nodes.size());
+        node.count[k] = 0;
+        nodes.emplace_back();
+        sources.push_back(children[k]);
+      }
+    }
+  }
+  refit(boxes);
+}
+
+void WideBVH::refit(const std::vector<BoundingBox> & boxes)
+{
+  const int width = WideBVHNode::width;
+  // Exact bounds of every node; children come after their parent, so a
+  // reverse sweep has them ready
+  std::vector<BoundingBox> node_boxes(nodes.size());
+  for(int i = static_cast<int>(nodes.size())-1;i>=0;i--)
+  {
+    const WideBVHNode & node = nodes[i];
+    BoundingBox child_boxes[width];
+    for(int k = 0;k<width;k++)
+    {
+      if(node.child[k] < 0)
+      {
+        continue;
+      }
+      if(node.count[k] == 0)
+      {
+        child_boxes[k] = node_boxes[node.child[k]];
+      }else
+      {
+        for(int j = node.child[k];j<node.child[k]+node.count[k];j++)
+        {
+          child_boxes[k].extend(boxes[indices[j]]);
+        }
+      }
+      node_boxes[i].extend(child_boxes[k]);
+    }
+    quantize(i,child_boxes);
+  }
+  root_box = nodes.empty() ? BoundingBox() : node_boxes[0];
+}
+
+bool WideBVH::valid(const int num_primitives) const
+{
+  const int width = WideBVHNode::width;
+  for(const int index : indices)
+  {
+    if(index < 0 || index >= num_primitives)
+    {
+      return false;
+    }
+  }
+  // Children come after their parent, so depths are known in node order
+  // and no path can loop
+  const int num_nodes = static_cast<int>(nodes.size());
+  std::vector<int> depth(nodes.size(),0);
+  for(int i = 0;i<num_nodes;i++)
+  {
+    const WideBVHNode & node = nodes[i];
+    for(int k = 0;k<width;k++)
+    {
+      const int child = node.child[k];
+      if(child < 0)
+      {
+        if(child != -1 || node.count[k] != 0) return false;
+      }else if(node.count[k] == 0)
+      {
+        if(child <= i || child >= num_nodes) return false;
+        depth[child] = depth[i]+1;
+        // Same bound as the binary trees' traversal stacks
+        if(depth[child] >= 64) return false;
+      }else if(int64_t(child)+node.count[k] > int64_t(indices.size()))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void WideBVH::quantize(const int i, const BoundingBox * child_boxes)
+{
+  const int width = WideBVHNode::width;
+  WideBVHNode & node = nodes[i];
+  BoundingBox box;
+  for(int k = 0;k<width;k++)
+  {
+    if(node.child[k] >= 0)
+    {
+      box.extend(child_boxes[k]);
+    }
+  }
+  const double max_extent = (box.max_corner-box.min_corner).maxCoeff();
+  for(int a = 0;a<3;a++)
+  {
+    // Grid origin at or below the box, in the precision traversal uses
+    float origin = static_cast<float>(box.min_corner(a));
+    if(origin > box.min_corner(a))
+    {
+      origin = std::nextafter(origin,-std::numeric_limits<float>::infinity());
+    }
+    // Smallest power of two step that spans the box in 255 steps (with a
+    // floor so flat boxes still get some thickness)
+    const double extent = std::max(
+      box.max_corner(a)-origin,std::max(1e-4*max_extent,1e-30));
+    int exponent = static_cast<int>(std::ceil(std::log2(extent/254.0)));
+    exponent = std::min(std::max(exponent,-126),127);
+    const float scale = exp2_int(exponent);
+    node.origin[a] = origin;
+    node.exponent[a] = static_cast<int8_t>(exponent);
+    for(int k = 0;k<width;k++)
+    {
+      if(node.child[k] < 0)
+      {
+        node.lo[a][k] = 255;
+        node.hi[a][k] = 0;
+        continue;
+      }
+      const BoundingBox & child = child_boxes[k];
+      // Round outwards, then step further out until the decoded float
+      // bounds contain the child
+      int lo = static_cast<int>(std::floor((child.min_corner(a)-origin)/scale));
+      int hi = static_cast<int>(std::ceil((child.max_corner(a)-origin)/scale));
+      lo = std::min(std::max(lo,0),255);
+      hi = std::min(std::max(hi,0),255);
+      while(lo > 0 && origin + lo*scale > child.min_corner(a)) lo--;
+      while(hi < 255 && origin + hi*scale < child.max_corner(a)) hi++;
+      node.lo[a][k] = static_cast<uint8_t>(lo);
+      node.hi[a][k] = static_cast<uint8_t>(hi);
+    }
+  }
+}
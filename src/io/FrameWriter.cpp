@@ -0,0 +1,71 @@
+#include "FrameWriter.h"
+#include "write_ppm.h"
+#include <algorithm>
+#include <utility>
+
+FrameWriter::FrameWriter(size_t max_pending_)
+  : max_pending(std::max<size_t>(max_pending_, 1))
+{
+  worker = std::thread(&FrameWriter::run, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  queued.notify_all();
+  worker.join();
+}
+
+void FrameWriter::write(
+  const std::string & filename,
+  std::vector<unsigned char> && data,
+  const int width,
+  const int height,
+  const int num_channels)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  drained.wait(lock, [&] { return frames.size() < max_pending; });
+  frames.push_back({filename, std::move(data), width, height, num_channels});
+  lock.unlock();
+  queued.notify_one();
+}
+
+int FrameWriter::flush()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  drained.wait(lock, [&] { return frames.empty() && !busy; });
+  return failures;
+}
+
+void FrameWriter::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true)
+  {
+    queued.wait(lock, [&] { return stopping || !frames.empty(); });
+    if(frames.empty())
+    {
+      // Only reached when stopping with nothing left to write
+      return;
+    }
+    Frame frame = std::move(frames.front());
+    frames.pop_front();
+    busy = true;
+    lock.unlock();
+    // Let a blocked write() refill the queue while this frame is on disk
+    drained.notify_all();
+    const bool ok = write_ppm(
+      frame.filename, frame.data, frame.width, frame.height,
+      frame.num_channels);
+    lock.lock();
+    busy = false;
+    if(!ok)
+    {
+      failures++;
+    }
+    drained.notify_all();
+  }
+}
@@ -0,0 +1,162 @@
+#include "GeometryPager.h"
+#include "read_stl.h"
+#include <algorithm>
+#include <limits>
+
+// Bytes held by a loaded mesh
+static size_t mesh_bytes(const PackedMesh & mesh)
+{
+  return mesh.V.size()*sizeof(float) + mesh.F.size()*sizeof(int) +
+    mesh.N.size()*sizeof(float) +
+    mesh.bvh.nodes.size()*sizeof(WideBVHNode) + mesh.bvh.indices.size()*sizeof(int);
+}
+
+GeometryPager::GeometryPager(size_t a_memory_cap)
+  : memory_cap(a_memory_cap)
+{
+  worker = std::thread(&GeometryPager::run, this);
+}
+
+GeometryPager::~GeometryPager()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  requested.notify_all();
+  worker.join();
+}
+
+int GeometryPager::add(
+  const std::string & filename,
+  const BVHBuild method,
+  const MeshNormals normals,
+  const double corner_threshold)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  slots.emplace_back();
+  slots.back().filename = filename;
+  slots.back().method = method;
+  slots.back().normals = normals;
+  slots.back().corner_threshold = corner_threshold;
+  return static_cast<int>(slots.size())-1;
+}
+
+const PackedMesh * GeometryPager::acquire(const int handle)
+{
+  Slot & slot = slots[handle];
+  const uint64_t now = frame.load(std::memory_order_relaxed);
+  // Skip the store (and the cache line ping-pong) when already stamped
+  if(slot.last_hit.load(std::memory_order_relaxed) != now)
+  {
+    slot.last_hit.store(now,std::memory_order_relaxed);
+  }
+  const PackedMesh * mesh = slot.mesh.load(std::memory_order_acquire);
+  if(!mesh)
+  {
+    int expected = unloaded;
+    if(slot.state.compare_exchange_strong(expected,queued))
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(handle);
+      }
+      requested.notify_one();
+    }
+  }
+  return mesh;
+}
+
+void GeometryPager::next_frame()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  const uint64_t now = ++frame;
+  retired.erase(
+    std::remove_if(retired.begin(),retired.end(),
+      [&](const std::pair<uint64_t,std::shared_ptr<const PackedMesh> > & r)
+      {
+        return r.first < now;
+      }),
+    retired.end());
+}
+
+uint64_t GeometryPager::wait_idle()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [&] { return pending.empty() && !busy; });
+  return completed;
+}
+
+void GeometryPager::evict(const int keep)
+{
+  const uint64_t now = frame.load(std::memory_order_relaxed);
+  while(resident > memory_cap)
+  {
+    int victim = -1;
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for(size_t s = 0;s<slots.size();s++)
+    {
+      const uint64_t hit = slots[s].last_hit.load(std::memory_order_relaxed);
+      if(static_cast<int>(s) != keep &&
+        slots[s].state.load() == resident_state && hit < now && hit < oldest)
+      {
+        victim = static_cast<int>(s);
+        oldest = hit;
+      }
+    }
+    if(victim < 0)
+    {
+      // Everything resident was hit this frame
+      return;
+    }
+    Slot & slot = slots[victim];
+    slot.mesh.store(nullptr,std::memory_order_release);
+    // Rays of this frame may still be inside it
+    retired.emplace_back(frame.load(),std::move(slot.owner));
+    slot.owner.reset();
+    slot.state.store(unloaded);
+    resident -= slot.bytes;
+    slot.bytes = 0;
+  }
+}
+
+void GeometryPager::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true)
+  {
+    requested.wait(lock, [&] { return stopping || !pending.empty(); });
+    if(stopping)
+    {
+      return;
+    }
+    const int handle = pending.front();
+    pending.pop_front();
+    busy = true;
+    const std::string filename = slots[handle].filename;
+    const BVHBuild method = slots[handle].method;
+    const MeshNormals normals = slots[handle].normals;
+    const double corner_threshold = slots[handle].corner_threshold;
+    lock.unlock();
+    std::shared_ptr<PackedMesh> mesh(new PackedMesh());
+    if(read_stl(filename,*mesh))
+    {
+      mesh->build_bvh(method);
+      mesh->compute_normals(normals,corner_threshold);
+    }else
+    {
+      *mesh = PackedMesh();
+    }
+    lock.lock();
+    Slot & slot = slots[handle];
+    slot.bytes = mesh_bytes(*mesh);
+    resident += slot.bytes;
+    slot.owner = mesh;
+    slot.mesh.store(mesh.get(),std::memory_order_release);
+    slot.state.store(resident_state);
+    completed++;
+    evict(handle);
+    busy = false;
+    idle.notify_all();
+  }
+}
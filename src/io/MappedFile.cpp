@@ -0,0 +1,107 @@
+#include "MappedFile.h"
+
+#if defined(WIN32) || defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+
+bool MappedFile::open(const std::string & filename)
+{
+  close();
+  HANDLE file = CreateFileA(
+    filename.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,nullptr);
+  if(file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if(!GetFileSizeEx(file,&size))
+  {
+    CloseHandle(file);
+    return false;
+  }
+  file_handle = file;
+  num_bytes = static_cast<size_t>(size.QuadPart);
+  if(num_bytes == 0)
+  {
+    return true;
+  }
+  HANDLE mapping = CreateFileMappingA(file,nullptr,PAGE_READONLY,0,0,nullptr);
+  if(mapping == nullptr)
+  {
+    close();
+    return false;
+  }
+  mapping_handle = mapping;
+  bytes = static_cast<const unsigned char *>(
+    MapViewOfFile(mapping,FILE_MAP_READ,0,0,0));
+  if(bytes == nullptr)
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::close()
+{
+  if(bytes) UnmapViewOfFile(bytes);
+  if(mapping_handle) CloseHandle(static_cast<HANDLE>(mapping_handle));
+  if(file_handle) CloseHandle(static_cast<HANDLE>(file_handle));
+  bytes = nullptr;
+  num_bytes = 0;
+  mapping_handle = nullptr;
+  file_handle = nullptr;
+}
+
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+
+bool MappedFile::open(const std::string & filename)
+{
+  close();
+  const int fd = ::open(filename.c_str(),O_RDONLY);
+  if(fd < 0)
+  {
+    return false;
+  }
+  struct stat info;
+  if(fstat(fd,&info) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  num_bytes = static_cast<size_t>(info.st_size);
+  if(num_bytes > 0)
+  {
+    void * mapped = mmap(nullptr,num_bytes,PROT_READ,MAP_PRIVATE,fd,0);
+    if(mapped == MAP_FAILED)
+    {
+      ::close(fd);
+      num_bytes = 0;
+      return false;
+    }
+    // Loaders stream through the file front to back
+    madvise(mapped,num_bytes,MADV_SEQUENTIAL);
+    bytes = static_cast<const unsigned char *>(mapped);
+  }
+  // The mapping keeps its own reference to the file
+  ::close(fd);
+  return true;
+}
+
+void MappedFile::close()
+{
+  if(bytes)
+  {
+    munmap(const_cast<unsigned char *>(bytes),num_bytes);
+  }
+  bytes = nullptr;
+  num_bytes = 0;
+}
+#endif
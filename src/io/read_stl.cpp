@@ -0,0 +1,174 @@
+#include "read_stl.h"
+#include "MappedFile.h"
+#include "weld_vertices.h"
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+  const size_t header_size = 80;
+  const size_t record_size = 50;
+
+  // Binary iff the triangle count in the header accounts for the exact file
+  // size, or the file does not even start with "solid".
+  bool is_binary_stl(const unsigned char * data, const size_t size)
+  {
+    if(size < header_size+4)
+    {
+      return false;
+    }
+    uint32_t num_faces;
+    std::memcpy(&num_faces,data+header_size,sizeof(num_faces));
+    if(header_size+4+record_size*static_cast<size_t>(num_faces) == size)
+    {
+      return true;
+    }
+    return std::strncmp(reinterpret_cast<const char *>(data),"solid",5) != 0;
+  }
+
+  bool read_binary_stl(
+    const unsigned char * data,
+    const size_t size,
+    std::vector<float> & P)
+  {
+    uint32_t num_faces;
+    std::memcpy(&num_faces,data+header_size,sizeof(num_faces));
+    if(header_size+4+record_size*static_cast<size_t>(num_faces) > size)
+    {
+      return false;
+    }
+    P.resize(9*static_cast<size_t>(num_faces));
+    const unsigned char * records = data+header_size+4;
+    #pragma omp parallel for
+    for(int64_t f = 0;f<static_cast<int64_t>(num_faces);f++)
+    {
+      // Skip the 12-byte facet normal; records are not 4-byte aligned
+      std::memcpy(&P[9*f],records+record_size*f+12,9*sizeof(float));
+    }
+    return true;
+  }
+
+  // Minimal tokenizer over the mapped text: only "vertex x y z" carries
+  // information, every other keyword (solid, facet normal, outer loop, ...)
+  // is skipped.
+  class AsciiTokenizer
+  {
+    public:
+      AsciiTokenizer(const char * a_begin, const char * a_end)
+        : cur(a_begin), end(a_end) {}
+      // Advance to the next whitespace separated token
+      bool next(const char *& token, size_t & length)
+      {
+        while(cur < end && is_space(*cur)) cur++;
+        if(cur == end) return false;
+        token = cur;
+        while(cur < end && !is_space(*cur)) cur++;
+        length = static_cast<size_t>(cur-token);
+        return true;
+      }
+      bool next_float(float & x)
+      {
+        const char * token;
+        size_t length;
+        if(!next(token,length)) return false;
+#if defined(__cpp_lib_to_chars)
+        const auto result = std::from_chars(token,token+length,x);
+        return result.ec == std::errc() && result.ptr == token+length;
+#else
+        char buffer[64];
+        if(length >= sizeof(buffer)) return false;
+        std::memcpy(buffer,token,length);
+        buffer[length] = '\0';
+        char * parsed_end;
+        x = std::strtof(buffer,&parsed_end);
+        return parsed_end == buffer+length;
+#endif
+      }
+    private:
+      static bool is_space(const char c)
+      {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t' ||
+               c == '\v' || c == '\f';
+      }
+      const char * cur;
+      const char * end;
+  };
+
+  bool read_ascii_stl(
+    const unsigned char * data,
+    const size_t size,
+    std::vector<float> & P)
+  {
+    const char * text = reinterpret_cast<const char *>(data);
+    // A facet takes roughly 250 bytes of text
+    P.reserve(9*(size/250+1));
+    AsciiTokenizer tokens(text,text+size);
+    const char * token;
+    size_t length;
+    while(tokens.next(token,length))
+    {
+      if(length == 6 && std::strncmp(token,"vertex",6) == 0)
+      {
+        float x, y, z;
+        if(!tokens.next_float(x) || !tokens.next_float(y) || !tokens.next_float(z))
+        {
+          return false;
+        }
+        P.push_back(x);
+        P.push_back(y);
+        P.push_back(z);
+      }
+    }
+    return P.size() % 9 == 0;
+  }
+}
+
+// Corner positions of all triangles (9 floats per triangle)
+static bool read_stl_corners(const std::string & filename, std::vector<float> & P)
+{
+  MappedFile file;
+  if(!file.open(filename))
+  {
+    fprintf(stderr,"IOError: %s could not be opened...\n",filename.c_str());
+    return false;
+  }
+  const bool ok = is_binary_stl(file.data(),file.size()) ?
+    read_binary_stl(file.data(),file.size(),P) :
+    read_ascii_stl(file.data(),file.size(),P);
+  if(!ok)
+  {
+    fprintf(stderr,"IOError: %s is not a valid .stl file\n",filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool read_stl(const std::string & filename, PackedMesh & mesh)
+{
+  std::vector<float> P;
+  if(!read_stl_corners(filename,P))
+  {
+    return false;
+  }
+  weld_vertices(P,mesh.V,mesh.F);
+  return true;
+}
+
+bool read_stl_bounds(const std::string & filename, BoundingBox & bounds)
+{
+  std::vector<float> P;
+  if(!read_stl_corners(filename,P))
+  {
+    return false;
+  }
+  bounds = BoundingBox();
+  for(size_t i = 0;i+2<P.size();i += 3)
+  {
+    bounds.extend(Eigen::Vector3d(P[i],P[i+1],P[i+2]));
+  }
+  return true;
+}
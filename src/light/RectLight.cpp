@@ -0,0 +1,18 @@
+#include "RectLight.h"
+
+void RectLight::direction(
+  const Eigen::Vector3d & q, Eigen::Vector3d & d, double & max_t) const
+{
+  sample_direction(q,0.5,0.5,d,max_t);
+}
+
+void RectLight::sample_direction(
+  const Eigen::Vector3d & q,
+  const double u,
+  const double v,
+  Eigen::Vector3d & d,
+  double & max_t) const
+{
+  d = corner + u*edge_u + v*edge_v - q;
+  max_t = d.norm();
+}
@@ -0,0 +1,39 @@
+#include "SphereLight.h"
+#include <Eigen/Geometry>
+#include <cmath>
+
+void SphereLight::direction(
+  const Eigen::Vector3d & q, Eigen::Vector3d & d, double & max_t) const
+{
+  d = p-q;
+  max_t = d.norm();
+}
+
+void SphereLight::sample_direction(
+  const Eigen::Vector3d & q,
+  const double u,
+  const double v,
+  Eigen::Vector3d & d,
+  double & max_t) const
+{
+  const Eigen::Vector3d to_center = p-q;
+  const double distance = to_center.norm();
+  if(distance <= radius)
+  {
+    // Inside the light: fully lit
+    d = to_center;
+    max_t = distance;
+    return;
+  }
+  // Orthonormal frame of the disk facing q
+  const Eigen::Vector3d w = to_center/distance;
+  const Eigen::Vector3d helper =
+    std::abs(w.x()) < 0.9 ? Eigen::Vector3d(1,0,0) : Eigen::Vector3d(0,1,0);
+  const Eigen::Vector3d a = w.cross(helper).normalized();
+  const Eigen::Vector3d b = w.cross(a);
+  // Uniform over the disk
+  const double r = radius*std::sqrt(u);
+  const double phi = 2.0*M_PI*v;
+  d = to_center + r*(std::cos(phi)*a + std::sin(phi)*b);
+  max_t = d.norm();
+}
@@ -0,0 +1,28 @@
+#include "pack_mesh.h"
+#include <cassert>
+
+std::shared_ptr<PackedMesh> pack_mesh(
+  const Eigen::MatrixXd & V,
+  const Eigen::MatrixXi & F,
+  const BVHBuild method,
+  const MeshNormals normals)
+{
+  assert((F.size() == 0 || F.cols() == 3 || F.cols() == 4) && "F must have 3 or 4 columns");
+  auto mesh = std::make_shared<PackedMesh>();
+  mesh->V = V.cast<float>();
+  if(F.cols() == 4)
+  {
+    mesh->F.resize(2*F.rows(),3);
+    for(int f = 0;f<F.rows();f++)
+    {
+      mesh->F.row(2*f+0) << F(f,0), F(f,1), F(f,2);
+      mesh->F.row(2*f+1) << F(f,0), F(f,2), F(f,3);
+    }
+  }else if(F.cols() == 3)
+  {
+    mesh->F = F;
+  }
+  mesh->build_bvh(method);
+  mesh->compute_normals(normals);
+  return mesh;
+}
@@ -0,0 +1,147 @@
+#include "weld_vertices.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <omp.h>
+
+namespace
+{
+  // Bit pattern of a coordinate with -0 folded onto +0
+  inline uint32_t coordinate_bits(const float x)
+  {
+    const float y = x + 0.0f;
+    uint32_t bits;
+    std::memcpy(&bits,&y,sizeof(bits));
+    return bits;
+  }
+
+  inline uint32_t hash_position(const float * p)
+  {
+    uint32_t h = coordinate_bits(p[0])*73856093u ^
+                 coordinate_bits(p[1])*19349663u ^
+                 coordinate_bits(p[2])*83492791u;
+    // murmur3 finalizer to spread the bits over the whole table
+    h ^= h >> 16; h *= 0x85ebca6bu;
+    h ^= h >> 13; h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+  }
+
+  inline bool same_position(const float * a, const float * b)
+  {
+    return coordinate_bits(a[0]) == coordinate_bits(b[0]) &&
+           coordinate_bits(a[1]) == coordinate_bits(b[1]) &&
+           coordinate_bits(a[2]) == coordinate_bits(b[2]);
+  }
+}
+
+void weld_vertices(
+  const std::vector<float> & P,
+  PackedMesh::VertexMatrix & V,
+  PackedMesh::FaceMatrix & F)
+{
+  const int64_t num_corners = static_cast<int64_t>(P.size()/3);
+  // Open addressing table at most half full. Each slot holds the smallest
+  // corner index seen with that position (-1 if empty); slots never change
+  // position once claimed, which is what makes the lock-free updates safe.
+  size_t table_size = 16;
+  while(table_size < 2*static_cast<size_t>(num_corners)) table_size *= 2;
+  const size_t mask = table_size-1;
+  std::unique_ptr<std::atomic<int>[]> table(new std::atomic<int>[table_size]);
+  std::vector<int> rep(num_corners);
+
+  #pragma omp parallel
+  {
+    #pragma omp for
+    for(int64_t s = 0;s<static_cast<int64_t>(table_size);s++)
+    {
+      table[s].store(-1,std::memory_order_relaxed);
+    }
+    // Insert: claim an empty slot or lower the index stored in the slot that
+    // already holds this position.
+    #pragma omp for
+    for(int64_t i = 0;i<num_corners;i++)
+    {
+      const float * p = &P[3*i];
+      size_t h = hash_position(p) & mask;
+      int current = table[h].load();
+      while(true)
+      {
+        if(current < 0)
+        {
+          if(table[h].compare_exchange_weak(current,static_cast<int>(i))) break;
+        }else if(!same_position(&P[3*static_cast<int64_t>(current)],p))
+        {
+          h = (h+1) & mask;
+          current = table[h].load();
+        }else if(i < current)
+        {
+          if(table[h].compare_exchange_weak(current,static_cast<int>(i))) break;
+        }else
+        {
+          break;
+        }
+      }
+    }
+    // Look up the representative (first occurrence) of every corner
+    #pragma omp for
+    for(int64_t i = 0;i<num_corners;i++)
+    {
+      const float * p = &P[3*i];
+      size_t h = hash_position(p) & mask;
+      int current = table[h].load(std::memory_order_relaxed);
+      while(!same_position(&P[3*static_cast<int64_t>(current)],p))
+      {
+        h = (h+1) & mask;
+        current = table[h].load(std::memory_order_relaxed);
+      }
+      rep[i] = current;
+    }
+  }
+
+  // Number representatives in order of appearance: per-thread counts, then a
+  // prefix sum over threads, then a local scan.
+  std::vector<int> new_id(num_corners);
+  std::vector<int64_t> thread_offset(omp_get_max_threads()+1,0);
+  int64_t num_vertices = 0;
+  #pragma omp parallel
+  {
+    const int num_threads = omp_get_num_threads();
+    const int thread = omp_get_thread_num();
+    const int64_t begin = num_corners*thread/num_threads;
+    const int64_t end = num_corners*(thread+1)/num_threads;
+    int64_t count = 0;
+    for(int64_t i = begin;i<end;i++)
+    {
+      count += rep[i] == i ? 1 : 0;
+    }
+    thread_offset[thread+1] = count;
+    #pragma omp barrier
+    #pragma omp single
+    {
+      for(int t = 0;t<num_threads;t++)
+      {
+        thread_offset[t+1] += thread_offset[t];
+      }
+      num_vertices = thread_offset[num_threads];
+      V.resize(num_vertices,3);
+      F.resize(num_corners/3,3);
+    }
+    int64_t next = thread_offset[thread];
+    for(int64_t i = begin;i<end;i++)
+    {
+      if(rep[i] == i)
+      {
+        new_id[i] = static_cast<int>(next);
+        V.row(next++) << P[3*i+0], P[3*i+1], P[3*i+2];
+      }
+    }
+    #pragma omp barrier
+    #pragma omp for
+    for(int64_t i = 0;i<num_corners;i++)
+    {
+      F(i/3,i%3) = new_id[rep[i]];
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#include "FrameAccumulator.h"
+
+void FrameAccumulator::reset()
+{
+  sum.clear();
+  width = 0;
+  height = 0;
+  count = 0;
+}
+
+RenderResult FrameAccumulator::add(const LinearFrame & frame)
+{
+  if(frame.width != width || frame.height != height ||
+     sum.size() != frame.rgb.size())
+  {
+    reset();
+    width = frame.width;
+    height = frame.height;
+    sum.assign(frame.rgb.size(),0.0f);
+  }
+  for(size_t k = 0;k<sum.size();k++)
+  {
+    sum[k] += frame.rgb[k];
+  }
+  count++;
+  LinearFrame mean = average();
+  mean.stats = frame.stats;
+  mean.refined_pixels = frame.refined_pixels;
+  mean.planar_pixels = frame.planar_pixels;
+  mean.heat_mean = frame.heat_mean;
+  mean.heat_scale = frame.heat_scale;
+  return tonemap(mean);
+}
+
+LinearFrame FrameAccumulator::average() const
+{
+  LinearFrame mean;
+  mean.width = width;
+  mean.height = height;
+  mean.rgb.resize(sum.size());
+  const float inv_count = count > 0 ? 1.0f/count : 0.0f;
+  for(size_t k = 0;k<sum.size();k++)
+  {
+    mean.rgb[k] = sum[k]*inv_count;
+  }
+  return mean;
+}
@@ -0,0 +1,148 @@
+#include "RayGenerator.h"
+#include <cmath>
+
+const char *camera_model_name(const CameraModel model) {
+  switch (model) {
+  case CameraModel::perspective:
+    return "perspective";
+  case CameraModel::orthographic:
+    return "orthographic";
+  case CameraModel::fisheye:
+    return "fisheye";
+  case CameraModel::thin_lens:
+    return "thin_lens";
+  default:
+    return "unknown";
+  }
+}
+
+// Packet generation for one camera model. Each loop runs over the lanes of
+// a packet with nothing but arithmetic in it, so the compiler vectorizes
+// it.
+template <CameraModel model> struct RayModel;
+
+template <> struct RayModel<CameraModel::perspective> {
+  static void generate(const RayGenerator &g, const double *x,
+                       const double *y, const double * /*lens_samples*/,
+                       const int n, RayPacket &packet) {
+    for (int k = 0; k < n; ++k) {
+      packet.ox[k] = g.e.x();
+      packet.oy[k] = g.e.y();
+      packet.oz[k] = g.e.z();
+      packet.dx[k] = g.top_left.x() + x[k] * g.du.x() + y[k] * g.dv.x();
+      packet.dy[k] = g.top_left.y() + x[k] * g.du.y() + y[k] * g.dv.y();
+      packet.dz[k] = g.top_left.z() + x[k] * g.du.z() + y[k] * g.dv.z();
+    }
+  }
+};
+
+template <> struct RayModel<CameraModel::orthographic> {
+  static void generate(const RayGenerator &g, const double *x,
+                       const double *y, const double * /*lens_samples*/,
+                       const int n, RayPacket &packet) {
+    // The image plane rectangle, scaled to the focus distance and moved
+    // back to the eye
+    const Eigen::Vector3d corner =
+        g.focus_scale * (g.top_left + g.d * g.w) + g.e;
+    const Eigen::Vector3d du = g.focus_scale * g.du;
+    const Eigen::Vector3d dv = g.focus_scale * g.dv;
+    const Eigen::Vector3d direction = -g.d * g.w;
+    for (int k = 0; k < n; ++k) {
+      packet.ox[k] = corner.x() + x[k] * du.x() + y[k] * dv.x();
+      packet.oy[k] = corner.y() + x[k] * du.y() + y[k] * dv.y();
+      packet.oz[k] = corner.z() + x[k] * du.z() + y[k] * dv.z();
+      packet.dx[k] = direction.x();
+      packet.dy[k] = direction.y();
+      packet.dz[k] = direction.z();
+    }
+  }
+};
+
+template <> struct RayModel<CameraModel::fisheye> {
+  static void generate(const RayGenerator &g, const double *x,
+                       const double *y, const double * /*lens_samples*/,
+                       const int n, RayPacket &packet) {
+    const double cx = 0.5 * g.image_width;
+    const double cy = 0.5 * g.image_height;
+    for (int k = 0; k < n; ++k) {
+      // Offsets from the image centre (right, up) as angles
+      const double a = (x[k] - cx) * g.fisheye_scale;
+      const double b = (cy - y[k]) * g.fisheye_scale;
+      const double theta = std::sqrt(a * a + b * b);
+      // sin(theta)/theta, which tends to 1 at the centre
+      const double s = theta > 1e-9 ? std::sin(theta) / theta : 1.0;
+      const double c = std::cos(theta);
+      packet.ox[k] = g.e.x();
+      packet.oy[k] = g.e.y();
+      packet.oz[k] = g.e.z();
+      packet.dx[k] = g.d * (s * (a * g.u.x() + b * g.v.x()) - c * g.w.x());
+      packet.dy[k] = g.d * (s * (a * g.u.y() + b * g.v.y()) - c * g.w.y());
+      packet.dz[k] = g.d * (s * (a * g.u.z() + b * g.v.z()) - c * g.w.z());
+    }
+  }
+};
+
+template <> struct RayModel<CameraModel::thin_lens> {
+  static void generate(const RayGenerator &g, const double *x,
+                       const double *y, const double *lens_samples,
+                       const int n, RayPacket &packet) {
+    const double radius = g.lens.aperture;
+    for (int k = 0; k < n; ++k) {
+      // Uniform point on the aperture disk
+      const double r = radius * std::sqrt(lens_samples[2 * k]);
+      const double phi = 2.0 * M_PI * lens_samples[2 * k + 1];
+      const double lu = r * std::cos(phi);
+      const double lv = r * std::sin(phi);
+      const Eigen::Vector3d offset = lu * g.u + lv * g.v;
+      // The pinhole ray and this one meet at the focus distance; scale so
+      // t=1 still lands near the image plane
+      const Eigen::Vector3d pinhole =
+          g.top_left + x[k] * g.du + y[k] * g.dv;
+      const Eigen::Vector3d direction =
+          pinhole - offset / g.focus_scale;
+      packet.ox[k] = g.e.x() + offset.x();
+      packet.oy[k] = g.e.y() + offset.y();
+      packet.oz[k] = g.e.z() + offset.z();
+      packet.dx[k] = direction.x();
+      packet.dy[k] = direction.y();
+      packet.dz[k] = direction.z();
+    }
+  }
+};
+
+RayGenerator::RayGenerator(const Camera &camera, const int width,
+                           const int height, const Lens &a_lens)
+    : lens(a_lens), image_width(width), image_height(height), e(camera.e),
+      u(camera.u), v(camera.v), w(camera.w), d(camera.d) {
+  du = camera.width / width * camera.u;
+  dv = -camera.height / height * camera.v;
+  top_left = -camera.width / 2 * camera.u + camera.height / 2 * camera.v -
+             camera.d * camera.w;
+  focus_scale = lens.focus_distance > 0 ? lens.focus_distance / d : 1.0;
+  fisheye_scale = lens.fisheye_fov / height;
+  if (lens.model == CameraModel::thin_lens && lens.aperture <= 0) {
+    lens.model = CameraModel::perspective;
+  }
+  switch (lens.model) {
+  case CameraModel::orthographic:
+    generate_fn = RayModel<CameraModel::orthographic>::generate;
+    break;
+  case CameraModel::fisheye:
+    generate_fn = RayModel<CameraModel::fisheye>::generate;
+    break;
+  case CameraModel::thin_lens:
+    generate_fn = RayModel<CameraModel::thin_lens>::generate;
+    break;
+  default:
+    generate_fn = RayModel<CameraModel::perspective>::generate;
+    break;
+  }
+}
+
+void RayGenerator::ray(const double x, const double y, const double lens_u,
+                       const double lens_v, Ray &ray) const {
+  const double lens_samples[2] = {lens_u, lens_v};
+  RayPacket packet;
+  generate_fn(*this, &x, &y, lens_samples, 1, packet);
+  packet.get(0, ray);
+}
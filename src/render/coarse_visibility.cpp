@@ -0,0 +1,98 @@
+#include "coarse_visibility.h"
+#include "Beam.h"
+#include "first_hit.h"
+#include "profiler.h"
+#include "ray_stats.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+// First hit of the ray through one corner of the block grid
+struct CornerHit {
+  int id = -1;
+  Eigen::Vector3d p;
+  Eigen::Vector3d n;
+};
+
+// Whether corners a and b lie on the same plane of the same object
+bool same_plane(const CornerHit &a, const CornerHit &b, const double eps) {
+  return a.id >= 0 && a.id == b.id && a.n.dot(b.n) > 1.0 - 1e-9 &&
+         std::abs(a.n.dot(b.p - a.p)) <= eps;
+}
+
+} // namespace
+
+void coarse_visibility(const SceneSnapshot &scene,
+                       const RayGenerator &generator, const int block,
+                       CoarseVisibility &vis) {
+  vis = CoarseVisibility();
+  if (block <= 0) {
+    return;
+  }
+  RT_PROFILE_SCOPE(coarse_visibility);
+  const int width = generator.width();
+  const int height = generator.height();
+  vis.block = block;
+  vis.blocks_x = (width + block - 1) / block;
+  vis.blocks_y = (height + block - 1) / block;
+  const int corners_x = vis.blocks_x + 1;
+  const int corners_y = vis.blocks_y + 1;
+
+  // Corner rays go through pixel boundaries, so every ray of a block
+  // (jittered or not) lies inside the pyramid they span
+  std::vector<CornerHit> corners(static_cast<size_t>(corners_x) * corners_y);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int y = 0; y < corners_y; ++y) {
+    count_ray_stat(RayCounter::primary_rays, corners_x);
+    for (int x = 0; x < corners_x; ++x) {
+      Ray ray;
+      generator.ray(std::min(x * block, width), std::min(y * block, height),
+                    0.5, 0.5, ray);
+      CornerHit &c = corners[x + static_cast<size_t>(corners_x) * y];
+      double t;
+      if (first_hit(ray, 1.0, scene.objects, c.id, t, c.n, scene.accel.get())) {
+        c.p = ray.origin + t * ray.direction;
+      } else {
+        c.id = -1;
+      }
+    }
+  }
+
+  const size_t num_blocks = static_cast<size_t>(vis.blocks_x) * vis.blocks_y;
+  vis.hit_id.assign(num_blocks, -1);
+  vis.plane.resize(num_blocks);
+  int planar_pixels = 0;
+  #pragma omp parallel for schedule(dynamic, 1) reduction(+ : planar_pixels)
+  for (int by = 0; by < vis.blocks_y; ++by) {
+    for (int bx = 0; bx < vis.blocks_x; ++bx) {
+      const size_t c0 = bx + static_cast<size_t>(corners_x) * by;
+      // Counter-clockwise around the block
+      const std::array<const CornerHit *, 4> quad = {
+          &corners[c0], &corners[c0 + 1], &corners[c0 + 1 + corners_x],
+          &corners[c0 + corners_x]};
+      const double eps = 1e-5 * (1.0 + (quad[0]->p - generator.eye()).norm());
+      bool planar = true;
+      for (int k = 1; k < 4 && planar; ++k) {
+        planar = same_plane(*quad[0], *quad[k], eps);
+      }
+      if (!planar) {
+        continue;
+      }
+      const Beam beam(generator.eye(),
+                      {quad[0]->p, quad[1]->p, quad[2]->p, quad[3]->p});
+      const int id = quad[0]->id;
+      if (!scene.objects[id]->covers_beam(beam) ||
+          scene.accel->intersects_beam(beam, scene.objects)) {
+        continue;
+      }
+      const size_t b = bx + static_cast<size_t>(vis.blocks_x) * by;
+      vis.hit_id[b] = id;
+      vis.plane[b] << quad[0]->n, quad[0]->n.dot(quad[0]->p);
+      planar_pixels += (std::min((bx + 1) * block, width) - bx * block) *
+                       (std::min((by + 1) * block, height) - by * block);
+    }
+  }
+  vis.planar_pixels = planar_pixels;
+}
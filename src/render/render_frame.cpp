@@ -0,0 +1,439 @@
+#include "render_frame.h"
+#include "PixelSampler.h"
+#include "RayGenerator.h"
+#include "coarse_visibility.h"
+#include "profiler.h"
+#include "raycolor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Cheapest timestamp available: the cycle counter on x86, nanoseconds
+// elsewhere
+uint64_t read_cycle_counter() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||           \
+    defined(_M_IX86)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Running total that a pixel's cost is measured against
+uint64_t cost_counter(const RenderMode mode) {
+  switch (mode) {
+  case RenderMode::heat_cycles:
+    return read_cycle_counter();
+  case RenderMode::heat_tests:
+    return this_thread_ray_counters()
+        .counts[static_cast<int>(RayCounter::triangle_tests)]
+        .load(std::memory_order_relaxed);
+  case RenderMode::heat_depth:
+    // Mirror bounces form a single chain per pixel, so the number of
+    // reflection rays is the depth reached
+    return this_thread_ray_counters()
+        .counts[static_cast<int>(RayCounter::reflection_rays)]
+        .load(std::memory_order_relaxed);
+  default:
+    return 0;
+  }
+}
+
+// Blue (cheap) through cyan, green and yellow to red (expensive)
+Eigen::Vector3d heat_color(double s) {
+  s = std::clamp(s, 0.0, 1.0);
+  static const Eigen::Vector3d stops[5] = {
+      {0.0, 0.0, 0.5}, {0.0, 0.6, 1.0}, {0.1, 0.9, 0.2},
+      {1.0, 0.9, 0.0}, {0.9, 0.0, 0.0}};
+  const double x = s * 4.0;
+  const int k = std::min(static_cast<int>(x), 3);
+  return stops[k] + (x - k) * (stops[k + 1] - stops[k]);
+}
+
+// Replace the frame's colours by a heatmap of cost. Costs are scaled by
+// their 99th percentile (so a few outliers don't wash out the image), except
+// depth, which has a fixed range.
+void apply_heatmap(const std::vector<float> &cost, const RenderMode mode,
+                   LinearFrame &frame) {
+  if (cost.empty()) {
+    return;
+  }
+  double sum = 0;
+  for (float c : cost) {
+    sum += c;
+  }
+  frame.heat_mean = sum / cost.size();
+  if (mode == RenderMode::heat_depth) {
+    frame.heat_scale = 3.0;
+  } else {
+    std::vector<float> sorted = cost;
+    auto p99 = sorted.begin() + (sorted.size() - 1) * 99 / 100;
+    std::nth_element(sorted.begin(), p99, sorted.end());
+    frame.heat_scale = std::max<double>(*p99, 1.0);
+  }
+  for (size_t k = 0; k < cost.size(); ++k) {
+    const Eigen::Vector3d c = heat_color(cost[k] / frame.heat_scale);
+    frame.rgb[3 * k + 0] = static_cast<float>(c(0));
+    frame.rgb[3 * k + 1] = static_cast<float>(c(1));
+    frame.rgb[3 * k + 2] = static_cast<float>(c(2));
+  }
+}
+
+// How strongly pixels a and b differ: different objects count most, then
+// depth jumps (silhouettes against the same object), then colour contrast.
+// Zero means no antialiasing is needed between them.
+float edge_strength(const LinearFrame &frame, const std::vector<int> &ids,
+                    const std::vector<float> &depth, const size_t a,
+                    const size_t b) {
+  float contrast = 0.0f;
+  for (int c = 0; c < 3; ++c) {
+    contrast = std::max(contrast,
+                        std::abs(frame.rgb[3 * a + c] - frame.rgb[3 * b + c]));
+  }
+  if (ids[a] != ids[b]) {
+    return 2.0f + contrast;
+  }
+  const float near = std::min(depth[a], depth[b]);
+  if (std::isfinite(near) && std::abs(depth[a] - depth[b]) > 0.05f * near) {
+    return 1.0f + contrast;
+  }
+  return contrast > 0.1f ? contrast : 0.0f;
+}
+
+// Whether any light of the scene casts soft shadows
+bool has_area_lights(const SceneSnapshot &scene) {
+  for (const auto &light : scene.lights) {
+    if (light->max_shadow_samples() > 1) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Second pass of soft shadows: the first pass took one shadow sample per
+// area light and shading point. A pixel sits in a penumbra if some light it
+// sampled was seen both lit and blocked among the pixels of the same object
+// within penumbra_radius of it; trace those again sampling every stratum of
+// the area lights. Adds the cost of the new trace in heatmap modes,
+// replaces the colour otherwise. Returns the number of pixels traced again.
+int refine_soft_shadows(const std::shared_ptr<const SceneSnapshot> &scene,
+                        const RayGenerator &generator,
+                        const RenderSettings &settings,
+                        const std::vector<int> &ids,
+                        const std::vector<uint32_t> &lit,
+                        const std::vector<uint32_t> &blocked,
+                        std::vector<float> &cost, LinearFrame &frame) {
+  const int width = frame.width;
+  const int height = frame.height;
+  const int penumbra_radius = 2;
+  std::vector<char> penumbra(lit.size(), 0);
+  #pragma omp parallel for
+  for (int i = 0; i < height; ++i) {
+    for (int j = 0; j < width; ++j) {
+      const size_t p = j + static_cast<size_t>(width) * i;
+      const uint32_t sampled = lit[p] | blocked[p];
+      if (sampled == 0) {
+        continue;
+      }
+      uint32_t seen_lit = 0, seen_blocked = 0;
+      for (int y = std::max(i - penumbra_radius, 0);
+           y <= std::min(i + penumbra_radius, height - 1); ++y) {
+        for (int x = std::max(j - penumbra_radius, 0);
+             x <= std::min(j + penumbra_radius, width - 1); ++x) {
+          const size_t q = x + static_cast<size_t>(width) * y;
+          if (ids[q] == ids[p]) {
+            seen_lit |= lit[q];
+            seen_blocked |= blocked[q];
+          }
+        }
+      }
+      penumbra[p] = (sampled & seen_lit & seen_blocked) != 0;
+    }
+  }
+  std::vector<size_t> refine;
+  for (size_t p = 0; p < penumbra.size(); ++p) {
+    if (penumbra[p]) {
+      refine.push_back(p);
+    }
+  }
+  const bool heatmap = settings.mode != RenderMode::shaded;
+  const bool lens_samples = generator.uses_lens_samples();
+  const uint32_t pass = sample_pass(settings.seed, 0);
+
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (size_t r = 0; r < refine.size(); ++r) {
+    const size_t p = refine[r];
+    const int i = static_cast<int>(p / width);
+    const int j = static_cast<int>(p % width);
+    count_ray_stat(RayCounter::primary_rays);
+    const uint64_t cost_start = heatmap ? cost_counter(settings.mode) : 0;
+    // The same camera sample as the first pass
+    PixelSampler &sampler = this_thread_sampler();
+    sampler.begin(p, pass);
+    const double x = j + (settings.jitter ? sampler.next() : 0.5);
+    const double y = i + (settings.jitter ? sampler.next() : 0.5);
+    double lens_u = 0.5, lens_v = 0.5;
+    if (lens_samples) {
+      lens_u = sampler.next();
+      lens_v = sampler.next();
+    }
+    Ray ray;
+    generator.ray(x, y, lens_u, lens_v, ray);
+    Eigen::Vector3d rgb;
+    sampler.all_strata = true;
+    raycolor(ray, 1.0, scene->objects, scene->lights, 0, rgb,
+             scene->accel.get());
+    sampler.all_strata = false;
+    if (heatmap) {
+      cost[p] += static_cast<float>(cost_counter(settings.mode) - cost_start);
+      continue;
+    }
+    frame.rgb[3 * p + 0] = static_cast<float>(rgb(0));
+    frame.rgb[3 * p + 1] = static_cast<float>(rgb(1));
+    frame.rgb[3 * p + 2] = static_cast<float>(rgb(2));
+  }
+  return static_cast<int>(refine.size());
+}
+
+// Second pass of adaptive antialiasing: rank pixels by their strongest edge
+// to a neighbour and average aa_grid^2 stratified, jittered samples into
+// as many of them as the budget allows.
+int adaptive_supersample(const std::shared_ptr<const SceneSnapshot> &scene,
+                         const RayGenerator &generator,
+                         const RenderSettings &settings,
+                         const std::vector<int> &ids,
+                         const std::vector<float> &depth, LinearFrame &frame) {
+  const int width = frame.width;
+  const int height = frame.height;
+  const size_t num_pixels = static_cast<size_t>(width) * height;
+  const int grid = std::max(settings.aa_grid, 1);
+  const int samples = grid * grid;
+
+  std::vector<float> score(num_pixels, 0.0f);
+  #pragma omp parallel for
+  for (int i = 0; i < height; ++i) {
+    for (int j = 0; j < width; ++j) {
+      const size_t p = j + static_cast<size_t>(width) * i;
+      float s = 0.0f;
+      if (j > 0)
+        s = std::max(s, edge_strength(frame, ids, depth, p, p - 1));
+      if (j + 1 < width)
+        s = std::max(s, edge_strength(frame, ids, depth, p, p + 1));
+      if (i > 0)
+        s = std::max(s, edge_strength(frame, ids, depth, p, p - width));
+      if (i + 1 < height)
+        s = std::max(s, edge_strength(frame, ids, depth, p, p + width));
+      score[p] = s;
+    }
+  }
+  std::vector<size_t> refine;
+  for (size_t p = 0; p < num_pixels; ++p) {
+    if (score[p] > 0.0f) {
+      refine.push_back(p);
+    }
+  }
+  const size_t max_pixels = static_cast<size_t>(
+      std::max(settings.aa_budget, 0.0) * num_pixels / samples);
+  if (refine.size() > max_pixels) {
+    std::nth_element(refine.begin(), refine.begin() + max_pixels, refine.end(),
+                     [&](size_t a, size_t b) { return score[a] > score[b]; });
+    refine.resize(max_pixels);
+  }
+
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (size_t r = 0; r < refine.size(); ++r) {
+    const size_t p = refine[r];
+    const int i = static_cast<int>(p / width);
+    const int j = static_cast<int>(p % width);
+    count_ray_stat(RayCounter::primary_rays, samples);
+    Eigen::Vector3d sum(frame.rgb[3 * p + 0], frame.rgb[3 * p + 1],
+                        frame.rgb[3 * p + 2]);
+    PixelSampler &sampler = this_thread_sampler();
+    for (int s = 0; s < samples; ++s) {
+      sampler.begin(p, sample_pass(settings.seed, s + 1));
+      // One jittered sample per cell of a grid x grid stratification
+      const double x = j + (s % grid + sampler.next()) / grid;
+      const double y = i + (s / grid + sampler.next()) / grid;
+      double lens_u = 0.5, lens_v = 0.5;
+      if (generator.uses_lens_samples()) {
+        lens_u = sampler.next();
+        lens_v = sampler.next();
+      }
+      Ray ray;
+      generator.ray(x, y, lens_u, lens_v, ray);
+      Eigen::Vector3d rgb;
+      raycolor(ray, 1.0, scene->objects, scene->lights, 0, rgb,
+               scene->accel.get());
+      sum += rgb;
+    }
+    sum /= samples + 1;
+    frame.rgb[3 * p + 0] = static_cast<float>(sum(0));
+    frame.rgb[3 * p + 1] = static_cast<float>(sum(1));
+    frame.rgb[3 * p + 2] = static_cast<float>(sum(2));
+  }
+  return static_cast<int>(refine.size());
+}
+
+} // namespace
+
+const char *render_mode_name(const RenderMode mode) {
+  switch (mode) {
+  case RenderMode::shaded:
+    return "shaded";
+  case RenderMode::heat_cycles:
+    return "cycles";
+  case RenderMode::heat_tests:
+    return "tests";
+  case RenderMode::heat_depth:
+    return "depth";
+  default:
+    return "unknown";
+  }
+}
+
+LinearFrame render_linear(const std::shared_ptr<const SceneSnapshot> &scene,
+                          const Camera &cam, const int width, const int height,
+                          const RenderSettings &settings) {
+  const RenderMode mode = settings.mode;
+  LinearFrame frame;
+  frame.width = width;
+  frame.height = height;
+  frame.rgb.resize(3 * static_cast<size_t>(width) * height);
+  const bool heatmap = mode != RenderMode::shaded;
+  std::vector<float> cost(heatmap ? static_cast<size_t>(width) * height : 0);
+  // Adaptive antialiasing looks for edges in object ids and depths, soft
+  // shadows compare what pixels of the same object saw of the area lights
+  // (see PixelSampler)
+  const bool adaptive_aa = settings.adaptive_aa && !heatmap;
+  const bool soft_shadows = has_area_lights(*scene);
+  const size_t num_pixels = static_cast<size_t>(width) * height;
+  std::vector<int> ids(adaptive_aa || soft_shadows ? num_pixels : 0);
+  std::vector<float> depth(ids.size());
+  std::vector<uint32_t> shadow_lit(soft_shadows ? num_pixels : 0);
+  std::vector<uint32_t> shadow_blocked(shadow_lit.size());
+  // Drop counts from outside this frame
+  collect_ray_stats();
+  const RayGenerator generator(cam, width, height, settings.lens);
+  CoarseVisibility coarse;
+  // The pre-pass needs every ray to start at the eye
+  coarse_visibility(*scene, generator,
+                    generator.pinhole() ? settings.coarse_block : 0, coarse);
+  frame.planar_pixels = coarse.planar_pixels;
+  const bool lens_samples = generator.uses_lens_samples();
+
+  // Rows differ a lot in cost (sky vs. mirrors), so hand them out one by one
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < height; ++i) {
+    RT_PROFILE_SCOPE(rows);
+    count_ray_stat(RayCounter::primary_rays, width);
+    PixelSampler &sampler = this_thread_sampler();
+    const uint32_t pass = sample_pass(settings.seed, 0);
+    // Rays are generated a packet at a time along the row
+    const int n = RayPacket::size;
+    RayPacket packet;
+    double x[n], y[n], lens[2 * n];
+    uint32_t drawn[n];
+    for (int j = 0; j < width; ++j) {
+      const int k = j % n;
+      if (k == 0) {
+        RT_PROFILE_SCOPE(primary_rays);
+        const int count = std::min(n, width - j);
+        // Camera samples come first in each pixel's random sequence
+        for (int c = 0; c < count; ++c) {
+          sampler.begin(j + c + static_cast<size_t>(width) * i, pass);
+          x[c] = j + c + (settings.jitter ? sampler.next() : 0.5);
+          y[c] = i + (settings.jitter ? sampler.next() : 0.5);
+          if (lens_samples) {
+            lens[2 * c] = sampler.next();
+            lens[2 * c + 1] = sampler.next();
+          }
+          drawn[c] = sampler.index;
+        }
+        generator.generate(x, y, lens, count, packet);
+      }
+      const size_t pixel = j + static_cast<size_t>(width) * i;
+      sampler.begin(pixel, pass, drawn[k]);
+      const uint64_t cost_start = heatmap ? cost_counter(mode) : 0;
+      Eigen::Vector3d rgb(0, 0, 0);
+      Ray ray;
+      packet.get(k, ray);
+      const int planar = coarse.planar_block(i, j);
+      if (planar >= 0) {
+        // Known to hit the block's plane; no traversal needed
+        int id;
+        double t;
+        Eigen::Vector3d n;
+        coarse.first_hit(planar, ray, id, t, n);
+        shade_hit(ray, id, t, n, scene->objects, scene->lights, 0, rgb,
+                  scene->accel.get());
+        if (!ids.empty()) {
+          ids[pixel] = id;
+          depth[pixel] = static_cast<float>(t);
+        }
+      } else if (!ids.empty()) {
+        double t;
+        raycolor(ray, 1.0, scene->objects, scene->lights, 0, rgb,
+                 scene->accel.get(), &ids[pixel], &t);
+        depth[pixel] = static_cast<float>(t);
+      } else {
+        raycolor(ray, 1.0, scene->objects, scene->lights, 0, rgb,
+                 scene->accel.get());
+      }
+      if (heatmap) {
+        cost[pixel] = static_cast<float>(cost_counter(mode) - cost_start);
+      }
+      if (soft_shadows) {
+        shadow_lit[pixel] = sampler.shadow_lit;
+        shadow_blocked[pixel] = sampler.shadow_blocked;
+      }
+      frame.rgb[3 * pixel + 0] = static_cast<float>(rgb(0));
+      frame.rgb[3 * pixel + 1] = static_cast<float>(rgb(1));
+      frame.rgb[3 * pixel + 2] = static_cast<float>(rgb(2));
+    }
+  }
+  if (soft_shadows) {
+    refine_soft_shadows(scene, generator, settings, ids, shadow_lit,
+                        shadow_blocked, cost, frame);
+  }
+  if (adaptive_aa) {
+    frame.refined_pixels =
+        adaptive_supersample(scene, generator, settings, ids, depth, frame);
+  }
+  frame.stats = collect_ray_stats();
+  apply_heatmap(cost, mode, frame);
+  return frame;
+}
+
+RenderResult tonemap(const LinearFrame &frame) {
+  RT_PROFILE_SCOPE(pixel_packing);
+  RenderResult result;
+  result.width = frame.width;
+  result.height = frame.height;
+  result.stats = frame.stats;
+  result.heat_mean = frame.heat_mean;
+  result.heat_scale = frame.heat_scale;
+  result.refined_pixels = frame.refined_pixels;
+  result.planar_pixels = frame.planar_pixels;
+  result.pixels.resize(frame.rgb.size());
+  for (size_t k = 0; k < frame.rgb.size(); ++k) {
+    result.pixels[k] = static_cast<unsigned char>(
+        255.0f * std::max(std::min(frame.rgb[k], 1.0f), 0.0f));
+  }
+  return result;
+}
+
+RenderResult render_frame(std::shared_ptr<const SceneSnapshot> scene,
+                          const Camera &cam, const int width, const int height,
+                          const RenderSettings &settings) {
+  return tonemap(render_linear(scene, cam, width, height, settings));
+}
@@ -0,0 +1,29 @@
+#include "OrbitalCamera.h"
+#include <Eigen/Geometry>
+
+Eigen::Vector3d camera_forward(double yaw, double pitch) {
+  Eigen::Vector3d f(std::sin(yaw) * std::cos(pitch), std::sin(pitch),
+                    std::cos(yaw) * std::cos(pitch));
+  return f.normalized();
+}
+
+Eigen::Vector3d camera_eye(const OrbitalCamera &o) {
+  Eigen::Vector3d f = camera_forward(o.yaw, o.pitch);
+  return o.target - f * o.distance;
+}
+
+void fill_camera(const OrbitalCamera &o, Camera &cam, const double aspect) {
+  Eigen::Vector3d f = camera_forward(o.yaw, o.pitch);
+  Eigen::Vector3d e = o.target - f * o.distance;
+  Eigen::Vector3d v(0.0, 1.0, 0.0);
+  Eigen::Vector3d w = -f;
+  Eigen::Vector3d u = v.cross(w).normalized();
+  v = w.cross(u).normalized(); // keep v pointing up relative to w/u
+  cam.e = e;
+  cam.w = w;
+  cam.u = u;
+  cam.v = v;
+  cam.d = 1.0;
+  cam.height = 2.0 * cam.d * std::tan(o.vfov * 0.5);
+  cam.width = cam.height * aspect;
+}
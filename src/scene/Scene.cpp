@@ -0,0 +1,165 @@
+#include "Scene.h"
+#include "Instance.h"
+#include "LazyMesh.h"
+#include "Plane.h"
+#include "PointLight.h"
+#include "RectLight.h"
+#include "Sphere.h"
+#include "SphereLight.h"
+#include "Triangle.h"
+#include "TriangleSoup.h"
+#include <atomic>
+
+template <typename T>
+std::shared_ptr<T> Scene::editable_object(const int id)
+{
+  if(id < 0 || id >= static_cast<int>(objects.size()))
+  {
+    return nullptr;
+  }
+  const auto typed = std::dynamic_pointer_cast<T>(objects[id]);
+  if(!typed || object_copied[id])
+  {
+    return typed;
+  }
+  // The current object may be part of a published snapshot
+  const auto copy = std::make_shared<T>(*typed);
+  objects[id] = copy;
+  object_copied[id] = true;
+  return copy;
+}
+
+template <typename T>
+std::shared_ptr<T> Scene::editable_light(const int id)
+{
+  if(id < 0 || id >= static_cast<int>(lights.size()))
+  {
+    return nullptr;
+  }
+  const auto typed = std::dynamic_pointer_cast<T>(lights[id]);
+  if(!typed || light_copied[id])
+  {
+    return typed;
+  }
+  const auto copy = std::make_shared<T>(*typed);
+  lights[id] = copy;
+  light_copied[id] = true;
+  return copy;
+}
+
+std::shared_ptr<Object> Scene::editable_any_object(const int id)
+{
+  if(const auto instance = editable_object<Instance>(id)) return instance;
+  if(const auto sphere = editable_object<Sphere>(id)) return sphere;
+  if(const auto plane = editable_object<Plane>(id)) return plane;
+  if(const auto triangle = editable_object<Triangle>(id)) return triangle;
+  if(const auto soup = editable_object<TriangleSoup>(id)) return soup;
+  if(const auto lazy = editable_object<LazyMesh>(id)) return lazy;
+  return nullptr;
+}
+
+int Scene::add_object(const std::shared_ptr<Object> & object)
+{
+  objects.push_back(object);
+  // Never handed out yet, so it may be edited in place until the next commit
+  object_copied.push_back(true);
+  objects_added = true;
+  return static_cast<int>(objects.size())-1;
+}
+
+int Scene::add_light(const std::shared_ptr<Light> & light)
+{
+  lights.push_back(light);
+  light_copied.push_back(true);
+  return static_cast<int>(lights.size())-1;
+}
+
+bool Scene::set_transform(const int id, const Eigen::Affine3d & transform)
+{
+  const auto instance = editable_object<Instance>(id);
+  if(!instance)
+  {
+    return false;
+  }
+  instance->set_transform(transform);
+  objects_moved = true;
+  return true;
+}
+
+bool Scene::set_material(const int id, const std::shared_ptr<Material> & material)
+{
+  const auto object = editable_any_object(id);
+  if(!object)
+  {
+    return false;
+  }
+  object->material = material;
+  return true;
+}
+
+bool Scene::set_light_position(const int id, const Eigen::Vector3d & p)
+{
+  if(const auto point = editable_light<PointLight>(id))
+  {
+    point->p = p;
+  }else if(const auto sphere = editable_light<SphereLight>(id))
+  {
+    sphere->p = p;
+  }else
+  {
+    return false;
+  }
+  return true;
+}
+
+bool Scene::set_light_intensity(const int id, const Eigen::Vector3d & I)
+{
+  if(const auto point = editable_light<PointLight>(id))
+  {
+    point->I = I;
+  }else if(const auto sphere = editable_light<SphereLight>(id))
+  {
+    sphere->I = I;
+  }else if(const auto rect = editable_light<RectLight>(id))
+  {
+    rect->I = I;
+  }else
+  {
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<const SceneSnapshot> Scene::commit()
+{
+  // The BVH is replaced, never edited, since earlier snapshots share it
+  if(objects_added)
+  {
+    const auto rebuilt = std::make_shared<ObjectBVH>();
+    rebuilt->build(objects);
+    accel = rebuilt;
+  }else if(objects_moved)
+  {
+    const auto refitted = std::make_shared<ObjectBVH>(*accel);
+    refitted->update(objects);
+    accel = refitted;
+  }
+  objects_added = false;
+  objects_moved = false;
+  auto next = std::make_shared<SceneSnapshot>();
+  next->objects = objects;
+  next->lights = lights;
+  next->accel = accel;
+  next->version = ++version;
+  // Everything now belongs to the published snapshot
+  std::fill(object_copied.begin(),object_copied.end(),false);
+  std::fill(light_copied.begin(),light_copied.end(),false);
+  std::shared_ptr<const SceneSnapshot> snapshot = std::move(next);
+  std::atomic_store(&published,snapshot);
+  return snapshot;
+}
+
+std::shared_ptr<const SceneSnapshot> Scene::snapshot() const
+{
+  return std::atomic_load(&published);
+}
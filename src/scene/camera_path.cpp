@@ -0,0 +1,128 @@
+#include "camera_path.h"
+#include <json.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+  using json = nlohmann::json;
+
+  OrbitalCamera parse_orbit(const json & j, const OrbitalCamera & base)
+  {
+    OrbitalCamera o = base;
+    o.yaw = j.value("yaw", o.yaw);
+    o.pitch = j.value("pitch", o.pitch);
+    o.distance = j.value("distance", o.distance);
+    if(j.count("target"))
+    {
+      const json & t = j["target"];
+      o.target = Eigen::Vector3d(t[0], t[1], t[2]);
+    }
+    if(j.count("vfov_degrees"))
+    {
+      o.vfov = j["vfov_degrees"].get<double>() * M_PI / 180.0;
+    }
+    return o;
+  }
+
+  OrbitalCamera lerp(
+    const OrbitalCamera & a,
+    const OrbitalCamera & b,
+    const double s)
+  {
+    OrbitalCamera o;
+    o.yaw = (1.0 - s) * a.yaw + s * b.yaw;
+    o.pitch = (1.0 - s) * a.pitch + s * b.pitch;
+    o.distance = (1.0 - s) * a.distance + s * b.distance;
+    o.target = (1.0 - s) * a.target + s * b.target;
+    o.vfov = (1.0 - s) * a.vfov + s * b.vfov;
+    return o;
+  }
+}
+
+bool read_camera_path(
+  const std::string & filename,
+  const OrbitalCamera & start,
+  std::vector<OrbitalCamera> & path)
+{
+  path.clear();
+  std::ifstream infile(filename);
+  if(!infile)
+  {
+    return false;
+  }
+  try
+  {
+    json j;
+    infile >> j;
+    if(j.is_array())
+    {
+      // Each camera inherits whatever the previous one set
+      OrbitalCamera previous = start;
+      for(const json & c : j)
+      {
+        previous = parse_orbit(c, previous);
+        path.push_back(previous);
+      }
+      return !path.empty();
+    }
+
+    const json & keys = j.at("keyframes");
+    if(!keys.is_array() || keys.empty())
+    {
+      return false;
+    }
+    std::vector<std::pair<int,OrbitalCamera> > frames;
+    OrbitalCamera previous = start;
+    for(const json & k : keys)
+    {
+      previous = parse_orbit(k, previous);
+      frames.emplace_back(k.value("frame", 0), previous);
+    }
+    std::stable_sort(frames.begin(), frames.end(),
+      [](const std::pair<int,OrbitalCamera> & a,
+         const std::pair<int,OrbitalCamera> & b)
+      { return a.first < b.first; });
+    const int num_frames = j.value("frames", frames.back().first + 1);
+    path.resize(std::max(num_frames, 0));
+    size_t k = 0;
+    for(int f = 0; f < num_frames; f++)
+    {
+      while(k + 1 < frames.size() && frames[k + 1].first <= f)
+      {
+        k++;
+      }
+      if(f <= frames[k].first || k + 1 == frames.size())
+      {
+        // Hold the first/last keyframe outside the keyed range
+        path[f] = frames[k].second;
+      }else
+      {
+        const double s =
+          double(f - frames[k].first) /
+          double(frames[k + 1].first - frames[k].first);
+        path[f] = lerp(frames[k].second, frames[k + 1].second, s);
+      }
+    }
+    return !path.empty();
+  }catch(const json::exception & e)
+  {
+    std::cerr << "Error parsing camera path " << filename << ": " << e.what()
+              << "\n";
+    path.clear();
+    return false;
+  }
+}
+
+void turntable_path(
+  const OrbitalCamera & start,
+  const int frames,
+  std::vector<OrbitalCamera> & path)
+{
+  path.assign(std::max(frames, 0), start);
+  for(int f = 0; f < frames; f++)
+  {
+    path[f].yaw = start.yaw + 2.0 * M_PI * f / frames;
+  }
+}
@@ -0,0 +1,671 @@
+#include "scene_cache.h"
+#include "DirectionalLight.h"
+#include "Instance.h"
+#include "MappedFile.h"
+#include "PackedMesh.h"
+#include "Plane.h"
+#include "PointLight.h"
+#include "RectLight.h"
+#include "Sphere.h"
+#include "SphereLight.h"
+#include "Triangle.h"
+#include "dirname.h"
+#include "read_json.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+  // Bump whenever any of the Disk* layouts below change
+  const uint32_t format_version = 4;
+  const char format_magic[8] = {'R','T','S','C','E','N','E','\0'};
+  // Caches are only valid on machines with the same byte order
+  const uint32_t endian_marker = 0x01020304u;
+
+  enum ObjectType : uint32_t { SPHERE = 1, PLANE = 2, TRIANGLE = 3, INSTANCE = 4 };
+  enum LightType : uint32_t { POINT = 1, DIRECTIONAL = 2, SPHERE_LIGHT = 3, RECT = 4 };
+
+  // Byte range of an array of count records
+  struct Section
+  {
+    uint64_t offset;
+    uint64_t count;
+  };
+  struct Header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t content_hash;
+    uint64_t file_size;
+    Section dependencies;
+    Section strings;
+    Section camera;
+    Section materials;
+    Section lights;
+    Section objects;
+    Section meshes;
+  };
+  struct DiskCamera
+  {
+    double e[3], u[3], v[3], w[3];
+    double d, width, height;
+  };
+  struct DiskMaterial
+  {
+    double ka[3], kd[3], ks[3], km[3];
+    double phong_exponent;
+  };
+  struct DiskLight
+  {
+    uint32_t type;
+    // Most shadow samples (area lights)
+    int32_t samples;
+    double I[3];
+    // Position (point, sphere), direction (directional) or corner (rect)
+    double x[3];
+    // Edges (rect)
+    double u[3], v[3];
+    // Radius (sphere)
+    double radius;
+  };
+  struct DiskObject
+  {
+    uint32_t type;
+    // Index into the material/mesh tables, -1 for none
+    int32_t material;
+    int32_t mesh;
+    uint32_t padding;
+    // sphere: center, radius; plane: point, normal; triangle: corners;
+    // instance: top three rows of the object-to-world matrix (row-major)
+    double params[12];
+  };
+  struct DiskMesh
+  {
+    Section V;
+    Section F;
+    // MeshNormals and the shading normals it lays out
+    uint32_t normals;
+    uint32_t padding;
+    Section N;
+    // WideBVHNodes, stored as they are in memory
+    Section nodes;
+    Section indices;
+    double min_corner[3];
+    double max_corner[3];
+  };
+
+  // Word-at-a-time hash of a byte range. Chunks are hashed in parallel and
+  // folded in order, so the result does not depend on the thread count.
+  uint64_t hash_bytes(const unsigned char * data, const size_t size, uint64_t h)
+  {
+    const uint64_t prime = 0x100000001b3ull;
+    const uint64_t mix = 0x9e3779b97f4a7c15ull;
+    const size_t chunk_size = size_t(1) << 20;
+    const int64_t num_chunks = static_cast<int64_t>((size+chunk_size-1)/chunk_size);
+    std::vector<uint64_t> chunk_hash(num_chunks);
+    #pragma omp parallel for
+    for(int64_t c = 0;c<num_chunks;c++)
+    {
+      const unsigned char * begin = data + c*chunk_size;
+      const size_t length = std::min(chunk_size,size-c*chunk_size);
+      uint64_t ch = mix ^ static_cast<uint64_t>(c);
+      size_t i = 0;
+      for(;i+8<=length;i+=8)
+      {
+        uint64_t word;
+        std::memcpy(&word,begin+i,8);
+        ch = (ch ^ word) * mix;
+        ch ^= ch >> 29;
+      }
+      for(;i<length;i++)
+      {
+        ch = (ch ^ begin[i]) * prime;
+      }
+      chunk_hash[c] = ch;
+    }
+    h ^= static_cast<uint64_t>(size);
+    for(const uint64_t ch : chunk_hash)
+    {
+      h = (h ^ ch) * prime;
+    }
+    return h;
+  }
+
+  std::string dependency_path(const std::string & filename, const std::string & dependency)
+  {
+#if defined(WIN32) || defined(_WIN32)
+    return igl::dirname(filename) + "\\" + dependency;
+#else
+    return igl::dirname(filename) + "/" + dependency;
+#endif
+  }
+
+  // Append-only byte buffer with records aligned to 8 bytes (or more, as
+  // their type needs)
+  class Writer
+  {
+    public:
+      std::vector<unsigned char> bytes;
+      template <typename T>
+      Section append(const T * data, const size_t count)
+      {
+        const size_t align = std::max<size_t>(alignof(T),8);
+        bytes.resize((bytes.size()+align-1) & ~(align-1),0);
+        Section section{bytes.size(),count};
+        const unsigned char * begin = reinterpret_cast<const unsigned char *>(data);
+        bytes.insert(bytes.end(),begin,begin+sizeof(T)*count);
+        return section;
+      }
+  };
+
+  // Bounds-checked view of a mapped cache file
+  class Reader
+  {
+    public:
+      Reader(const unsigned char * a_data, const size_t a_size)
+        : data(a_data), size(a_size) {}
+      template <typename T>
+      const T * get(const Section & section) const
+      {
+        if(section.count == 0) return nullptr;
+        if(section.offset % alignof(T) != 0 ||
+           section.count > size/sizeof(T) ||
+           section.offset > size - sizeof(T)*section.count)
+        {
+          throw std::out_of_range("scene cache section out of range");
+        }
+        return reinterpret_cast<const T *>(data + section.offset);
+      }
+    private:
+      const unsigned char * data;
+      size_t size;
+  };
+
+  void copy3(const Eigen::Vector3d & v, double * out)
+  {
+    out[0] = v(0); out[1] = v(1); out[2] = v(2);
+  }
+  Eigen::Vector3d vec3(const double * in)
+  {
+    return Eigen::Vector3d(in[0],in[1],in[2]);
+  }
+}
+
+std::string scene_cache_path(const std::string & filename)
+{
+  return filename + ".scenecache";
+}
+
+bool scene_content_hash(
+  const std::string & filename,
+  const std::vector<std::string> & dependencies,
+  uint64_t & hash)
+{
+  uint64_t h = 0xcbf29ce484222325ull;
+  std::vector<std::string> paths(1,filename);
+  for(const std::string & dependency : dependencies)
+  {
+    paths.push_back(dependency_path(filename,dependency));
+  }
+  for(const std::string & path : paths)
+  {
+    MappedFile file;
+    if(!file.open(path))
+    {
+      return false;
+    }
+    h = hash_bytes(file.data(),file.size(),h);
+  }
+  hash = h;
+  return true;
+}
+
+bool write_scene_cache(
+  const std::string & cache_filename,
+  const uint64_t content_hash,
+  const std::vector<std::string> & dependencies,
+  const Camera & camera,
+  const std::vector<std::shared_ptr<Object> > & objects,
+  const std::vector<std::shared_ptr<Light> > & lights)
+{
+  Writer out;
+  Header header;
+  std::memset(&header,0,sizeof(header));
+  out.append(&header,1);
+
+  // Dependency paths: one (offset,length) record per path into a char pool
+  std::vector<Section> dependency_records;
+  std::string pool;
+  for(const std::string & dependency : dependencies)
+  {
+    dependency_records.push_back({pool.size(),dependency.size()});
+    pool += dependency;
+  }
+  header.dependencies = out.append(dependency_records.data(),dependency_records.size());
+  header.strings = out.append(pool.data(),pool.size());
+
+  DiskCamera disk_camera;
+  copy3(camera.e,disk_camera.e);
+  copy3(camera.u,disk_camera.u);
+  copy3(camera.v,disk_camera.v);
+  copy3(camera.w,disk_camera.w);
+  disk_camera.d = camera.d;
+  disk_camera.width = camera.width;
+  disk_camera.height = camera.height;
+  header.camera = out.append(&disk_camera,1);
+
+  std::vector<DiskLight> disk_lights;
+  for(const auto & light : lights)
+  {
+    DiskLight disk_light;
+    std::memset(&disk_light,0,sizeof(disk_light));
+    copy3(light->I,disk_light.I);
+    if(const auto point = std::dynamic_pointer_cast<PointLight>(light))
+    {
+      disk_light.type = POINT;
+      copy3(point->p,disk_light.x);
+    }else if(const auto directional = std::dynamic_pointer_cast<DirectionalLight>(light))
+    {
+      disk_light.type = DIRECTIONAL;
+      copy3(directional->d,disk_light.x);
+    }else if(const auto sphere = std::dynamic_pointer_cast<SphereLight>(light))
+    {
+      disk_light.type = SPHERE_LIGHT;
+      disk_light.samples = sphere->samples;
+      copy3(sphere->p,disk_light.x);
+      disk_light.radius = sphere->radius;
+    }else if(const auto rect = std::dynamic_pointer_cast<RectLight>(light))
+    {
+      disk_light.type = RECT;
+      disk_light.samples = rect->samples;
+      copy3(rect->corner,disk_light.x);
+      copy3(rect->edge_u,disk_light.u);
+      copy3(rect->edge_v,disk_light.v);
+    }else
+    {
+      return false;
+    }
+    disk_lights.push_back(disk_light);
+  }
+  header.lights = out.append(disk_lights.data(),disk_lights.size());
+
+  // Materials and meshes are shared by pointer; give each a table slot once
+  std::unordered_map<const Material *,int> material_index;
+  std::vector<DiskMaterial> disk_materials;
+  std::unordered_map<const PackedMesh *,int> mesh_index;
+  std::vector<const PackedMesh *> meshes;
+  std::vector<DiskObject> disk_objects;
+  for(const auto & object : objects)
+  {
+    DiskObject disk_object;
+    std::memset(&disk_object,0,sizeof(disk_object));
+    disk_object.material = -1;
+    disk_object.mesh = -1;
+    if(const Material * material = object->material.get())
+    {
+      auto found = material_index.find(material);
+      if(found == material_index.end())
+      {
+        DiskMaterial disk_material;
+        copy3(material->ka,disk_material.ka);
+        copy3(material->kd,disk_material.kd);
+        copy3(material->ks,disk_material.ks);
+        copy3(material->km,disk_material.km);
+        disk_material.phong_exponent = material->phong_exponent;
+        found = material_index.emplace(material,static_cast<int>(disk_materials.size())).first;
+        disk_materials.push_back(disk_material);
+      }
+      disk_object.material = found->second;
+    }
+    double * params = disk_object.params;
+    if(const auto sphere = std::dynamic_pointer_cast<Sphere>(object))
+    {
+      disk_object.type = SPHERE;
+      copy3(sphere->center,params);
+      params[3] = sphere->radius;
+    }else if(const auto plane = std::dynamic_pointer_cast<Plane>(object))
+    {
+      disk_object.type = PLANE;
+      copy3(plane->point,params);
+      copy3(plane->normal,params+3);
+    }else if(const auto triangle = std::dynamic_pointer_cast<Triangle>(object))
+    {
+      disk_object.type = TRIANGLE;
+      copy3(std::get<0>(triangle->corners),params);
+      copy3(std::get<1>(triangle->corners),params+3);
+      copy3(std::get<2>(triangle->corners),params+6);
+    }else if(const auto instance = std::dynamic_pointer_cast<Instance>(object))
+    {
+      if(!instance->mesh)
+      {
+        return false;
+      }
+      disk_object.type = INSTANCE;
+      auto found = mesh_index.find(instance->mesh.get());
+      if(found == mesh_index.end())
+      {
+        found = mesh_index.emplace(instance->mesh.get(),static_cast<int>(meshes.size())).first;
+        meshes.push_back(instance->mesh.get());
+      }
+      disk_object.mesh = found->second;
+      const Eigen::Matrix4d & M = instance->transform().matrix();
+      for(int r = 0;r<3;r++)
+      {
+        for(int c = 0;c<4;c++)
+        {
+          params[4*r+c] = M(r,c);
+        }
+      }
+    }else
+    {
+      return false;
+    }
+    disk_objects.push_back(disk_object);
+  }
+  header.materials = out.append(disk_materials.data(),disk_materials.size());
+  header.objects = out.append(disk_objects.data(),disk_objects.size());
+
+  std::vector<DiskMesh> disk_meshes;
+  for(const PackedMesh * mesh : meshes)
+  {
+    DiskMesh disk_mesh;
+    disk_mesh.V = out.append(mesh->V.data(),static_cast<size_t>(mesh->V.size()));
+    disk_mesh.F = out.append(mesh->F.data(),static_cast<size_t>(mesh->F.size()));
+    disk_mesh.normals = static_cast<uint32_t>(mesh->normals);
+    disk_mesh.padding = 0;
+    disk_mesh.N = out.append(mesh->N.data(),static_cast<size_t>(mesh->N.size()));
+    disk_mesh.nodes = out.append(mesh->bvh.nodes.data(),mesh->bvh.nodes.size());
+    copy3(mesh->bvh.root_box.min_corner,disk_mesh.min_corner);
+    copy3(mesh->bvh.root_box.max_corner,disk_mesh.max_corner);
+    disk_mesh.indices = out.append(mesh->bvh.indices.data(),mesh->bvh.indices.size());
+    disk_meshes.push_back(disk_mesh);
+  }
+  header.meshes = out.append(disk_meshes.data(),disk_meshes.size());
+
+  std::memcpy(header.magic,format_magic,sizeof(format_magic));
+  header.version = format_version;
+  header.endian = endian_marker;
+  header.content_hash = content_hash;
+  header.file_size = out.bytes.size();
+  std::memcpy(out.bytes.data(),&header,sizeof(header));
+
+  // Write next to the destination and rename over it, so a concurrent reader
+  // never maps a half-written file.
+  const std::string tmp_filename = cache_filename + ".tmp";
+  FILE * file = fopen(tmp_filename.c_str(),"wb");
+  if(file == NULL)
+  {
+    return false;
+  }
+  const bool written =
+    fwrite(out.bytes.data(),1,out.bytes.size(),file) == out.bytes.size();
+  if(fclose(file) != 0 || !written)
+  {
+    std::remove(tmp_filename.c_str());
+    return false;
+  }
+#if defined(WIN32) || defined(_WIN32)
+  std::remove(cache_filename.c_str());
+#endif
+  return std::rename(tmp_filename.c_str(),cache_filename.c_str()) == 0;
+}
+
+bool read_scene_cache(
+  const std::string & cache_filename,
+  const std::string & filename,
+  Camera & camera,
+  std::vector<std::shared_ptr<Object> > & objects,
+  std::vector<std::shared_ptr<Light> > & lights)
+{
+  MappedFile file;
+  if(!file.open(cache_filename) || file.size() < sizeof(Header))
+  {
+    return false;
+  }
+  Header header;
+  std::memcpy(&header,file.data(),sizeof(header));
+  if(std::memcmp(header.magic,format_magic,sizeof(format_magic)) != 0 ||
+     header.version != format_version ||
+     header.endian != endian_marker ||
+     header.file_size != file.size())
+  {
+    return false;
+  }
+  try
+  {
+    const Reader in(file.data(),file.size());
+
+    // Stale if the .json or anything it references changed
+    const Section * dependency_records = in.get<Section>(header.dependencies);
+    const char * pool = in.get<char>(header.strings);
+    std::vector<std::string> dependencies;
+    for(uint64_t i = 0;i<header.dependencies.count;i++)
+    {
+      const Section & record = dependency_records[i];
+      if(record.offset + record.count > header.strings.count)
+      {
+        return false;
+      }
+      dependencies.emplace_back(pool+record.offset,record.count);
+    }
+    uint64_t hash;
+    if(!scene_content_hash(filename,dependencies,hash) || hash != header.content_hash)
+    {
+      return false;
+    }
+
+    if(header.camera.count != 1)
+    {
+      return false;
+    }
+    const DiskCamera & disk_camera = *in.get<DiskCamera>(header.camera);
+    Camera loaded_camera;
+    loaded_camera.e = vec3(disk_camera.e);
+    loaded_camera.u = vec3(disk_camera.u);
+    loaded_camera.v = vec3(disk_camera.v);
+    loaded_camera.w = vec3(disk_camera.w);
+    loaded_camera.d = disk_camera.d;
+    loaded_camera.width = disk_camera.width;
+    loaded_camera.height = disk_camera.height;
+
+    std::vector<std::shared_ptr<Light> > loaded_lights;
+    const DiskLight * disk_lights = in.get<DiskLight>(header.lights);
+    for(uint64_t i = 0;i<header.lights.count;i++)
+    {
+      const DiskLight & disk_light = disk_lights[i];
+      if(disk_light.type == POINT)
+      {
+        std::shared_ptr<PointLight> light(new PointLight());
+        light->p = vec3(disk_light.x);
+        light->I = vec3(disk_light.I);
+        loaded_lights.push_back(light);
+      }else if(disk_light.type == DIRECTIONAL)
+      {
+        std::shared_ptr<DirectionalLight> light(new DirectionalLight());
+        light->d = vec3(disk_light.x);
+        light->I = vec3(disk_light.I);
+        loaded_lights.push_back(light);
+      }else if(disk_light.type == SPHERE_LIGHT)
+      {
+        std::shared_ptr<SphereLight> light(new SphereLight());
+        light->p = vec3(disk_light.x);
+        light->radius = disk_light.radius;
+        light->samples = disk_light.samples;
+        light->I = vec3(disk_light.I);
+        loaded_lights.push_back(light);
+      }else if(disk_light.type == RECT)
+      {
+        std::shared_ptr<RectLight> light(new RectLight());
+        light->corner = vec3(disk_light.x);
+        light->edge_u = vec3(disk_light.u);
+        light->edge_v = vec3(disk_light.v);
+        light->samples = disk_light.samples;
+        light->I = vec3(disk_light.I);
+        loaded_lights.push_back(light);
+      }else
+      {
+        return false;
+      }
+    }
+
+    std::vector<std::shared_ptr<Material> > materials;
+    const DiskMaterial * disk_materials = in.get<DiskMaterial>(header.materials);
+    for(uint64_t i = 0;i<header.materials.count;i++)
+    {
+      const DiskMaterial & disk_material = disk_materials[i];
+      std::shared_ptr<Material> material(new Material());
+      material->ka = vec3(disk_material.ka);
+      material->kd = vec3(disk_material.kd);
+      material->ks = vec3(disk_material.ks);
+      material->km = vec3(disk_material.km);
+      material->phong_exponent = disk_material.phong_exponent;
+      materials.push_back(material);
+    }
+
+    // Geometry and BVH arrays are bulk-copied out of the mapping so meshes
+    // own their memory and the cache can be rewritten while they are in use.
+    std::vector<std::shared_ptr<const PackedMesh> > meshes;
+    const DiskMesh * disk_meshes = in.get<DiskMesh>(header.meshes);
+    for(uint64_t i = 0;i<header.meshes.count;i++)
+    {
+      const DiskMesh & disk_mesh = disk_meshes[i];
+      if(disk_mesh.V.count % 3 != 0 || disk_mesh.F.count % 3 != 0)
+      {
+        return false;
+      }
+      const MeshNormals normals = static_cast<MeshNormals>(disk_mesh.normals);
+      const uint64_t expected_N =
+        normals == MeshNormals::flat ? 0 :
+        normals == MeshNormals::per_vertex ? disk_mesh.V.count :
+        normals == MeshNormals::per_corner ? 3*disk_mesh.F.count : 1;
+      if(disk_mesh.N.count != expected_N || disk_mesh.normals > 2)
+      {
+        return false;
+      }
+      std::shared_ptr<PackedMesh> mesh(new PackedMesh());
+      mesh->V = Eigen::Map<const PackedMesh::VertexMatrix>(
+        in.get<float>(disk_mesh.V),disk_mesh.V.count/3,3);
+      mesh->F = Eigen::Map<const PackedMesh::FaceMatrix>(
+        in.get<int32_t>(disk_mesh.F),disk_mesh.F.count/3,3);
+      mesh->normals = normals;
+      mesh->N = Eigen::Map<const PackedMesh::VertexMatrix>(
+        in.get<float>(disk_mesh.N),disk_mesh.N.count/3,3);
+      const WideBVHNode * disk_nodes = in.get<WideBVHNode>(disk_mesh.nodes);
+      mesh->bvh.nodes.assign(disk_nodes,disk_nodes+disk_mesh.nodes.count);
+      mesh->bvh.root_box = BoundingBox(
+        vec3(disk_mesh.min_corner),vec3(disk_mesh.max_corner));
+      const int32_t * indices = in.get<int32_t>(disk_mesh.indices);
+      mesh->bvh.indices.assign(indices,indices+disk_mesh.indices.count);
+      // The content hash only covers the sources, so a damaged cache of the
+      // right size gets this far: reject anything traversal would read out
+      // of bounds
+      if(mesh->F.size() > 0 &&
+         (mesh->F.minCoeff() < 0 || mesh->F.maxCoeff() >= mesh->V.rows()))
+      {
+        return false;
+      }
+      if(!mesh->bvh.valid(static_cast<int>(mesh->F.rows())))
+      {
+        return false;
+      }
+      meshes.push_back(mesh);
+    }
+
+    std::vector<std::shared_ptr<Object> > loaded_objects;
+    const DiskObject * disk_objects = in.get<DiskObject>(header.objects);
+    for(uint64_t i = 0;i<header.objects.count;i++)
+    {
+      const DiskObject & disk_object = disk_objects[i];
+      const double * params = disk_object.params;
+      std::shared_ptr<Object> object;
+      if(disk_object.type == SPHERE)
+      {
+        std::shared_ptr<Sphere> sphere(new Sphere());
+        sphere->center = vec3(params);
+        sphere->radius = params[3];
+        object = sphere;
+      }else if(disk_object.type == PLANE)
+      {
+        std::shared_ptr<Plane> plane(new Plane());
+        plane->point = vec3(params);
+        plane->normal = vec3(params+3);
+        object = plane;
+      }else if(disk_object.type == TRIANGLE)
+      {
+        std::shared_ptr<Triangle> tri(new Triangle());
+        tri->corners = std::make_tuple(vec3(params),vec3(params+3),vec3(params+6));
+        object = tri;
+      }else if(disk_object.type == INSTANCE)
+      {
+        if(disk_object.mesh < 0 || disk_object.mesh >= static_cast<int>(meshes.size()))
+        {
+          return false;
+        }
+        Eigen::Affine3d transform = Eigen::Affine3d::Identity();
+        for(int r = 0;r<3;r++)
+        {
+          for(int c = 0;c<4;c++)
+          {
+            transform.matrix()(r,c) = params[4*r+c];
+          }
+        }
+        object = std::make_shared<Instance>(meshes[disk_object.mesh],transform);
+      }else
+      {
+        return false;
+      }
+      if(disk_object.material >= static_cast<int>(materials.size()))
+      {
+        return false;
+      }
+      if(disk_object.material >= 0)
+      {
+        object->material = materials[disk_object.material];
+      }
+      loaded_objects.push_back(object);
+    }
+
+    camera = loaded_camera;
+    objects = std::move(loaded_objects);
+    lights = std::move(loaded_lights);
+    return true;
+  }catch(const std::out_of_range &)
+  {
+    return false;
+  }
+}
+
+bool read_scene_cached(
+  const std::string & filename,
+  Camera & camera,
+  std::vector<std::shared_ptr<Object> > & objects,
+  std::vector<std::shared_ptr<Light> > & lights,
+  const std::shared_ptr<GeometryPager> & pager)
+{
+  if(pager)
+  {
+    return read_json(filename,camera,objects,lights,nullptr,pager);
+  }
+  const std::string cache_filename = scene_cache_path(filename);
+  if(read_scene_cache(cache_filename,filename,camera,objects,lights))
+  {
+    return true;
+  }
+  std::vector<std::string> dependencies;
+  if(!read_json(filename,camera,objects,lights,&dependencies))
+  {
+    return false;
+  }
+  uint64_t hash;
+  if(!scene_content_hash(filename,dependencies,hash) ||
+     !write_scene_cache(cache_filename,hash,dependencies,camera,objects,lights))
+  {
+    std::cerr<<"Warning: could not write scene cache "<<cache_filename<<"\n";
+  }
+  return true;
+}
@@ -0,0 +1,270 @@
+#include "profiler.h"
+#include "thread_slots.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  // Stages that are coarse enough to record as individual trace events; the
+  // per-ray stages only show up in the per-collect counters.
+  bool traced(const int stage)
+  {
+    switch(static_cast<ProfileStage>(stage))
+    {
+      case ProfileStage::camera_setup:
+      case ProfileStage::coarse_visibility:
+      case ProfileStage::rows:
+      case ProfileStage::pixel_packing:
+      case ProfileStage::texture_upload:
+      case ProfileStage::present:
+        return true;
+      default:
+        return false;
+    }
+  }
+  // Keep traces of long sessions bounded (~50MB of json)
+  const size_t max_trace_events = 1 << 19;
+
+  struct TraceEvent
+  {
+    int stage;
+    int64_t start_us;
+    int64_t duration_us;
+  };
+
+  // Timers of one thread. Totals are only written by the owning thread
+  // (relaxed load+store, no locked instructions) and read by
+  // profile_collect(). Aligned so neighbouring threads never share a line.
+  struct alignas(64) ThreadProfile
+  {
+    ThreadProfile()
+    {
+      for(int s = 0; s < num_profile_stages; s++)
+      {
+        self_ns[s].store(0, std::memory_order_relaxed);
+        total_ns[s].store(0, std::memory_order_relaxed);
+        calls[s].store(0, std::memory_order_relaxed);
+      }
+    }
+    std::array<std::atomic<int64_t>,num_profile_stages> self_ns;
+    std::array<std::atomic<int64_t>,num_profile_stages> total_ns;
+    std::array<std::atomic<uint64_t>,num_profile_stages> calls;
+    // Owner only: open scopes per stage and innermost open scope
+    std::array<int,num_profile_stages> active{};
+    ProfileScope * current = nullptr;
+    std::mutex events_mutex;
+    std::vector<TraceEvent> events;
+    // Collector only (under the registry mutex): totals already reported
+    std::array<int64_t,num_profile_stages> seen_self_ns{};
+    std::array<int64_t,num_profile_stages> seen_total_ns{};
+    std::array<uint64_t,num_profile_stages> seen_calls{};
+  };
+
+  struct Registry
+  {
+    // Trace thread ids are indices into threads
+    ThreadSlots<ThreadProfile> threads;
+    std::mutex mutex;
+    const Clock::time_point epoch = Clock::now();
+    Clock::time_point last_collect = epoch;
+    std::atomic<bool> tracing{false};
+    std::atomic<size_t> num_events{0};
+    std::string trace_filename;
+    std::vector<std::pair<int64_t,FrameProfile> > counters;
+  };
+
+  Registry & registry()
+  {
+    static Registry r;
+    return r;
+  }
+
+  int64_t to_us(const Clock::duration d)
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  }
+
+  ThreadProfile & this_thread_profile()
+  {
+    thread_local ThreadSlots<ThreadProfile>::Lease lease(registry().threads);
+    return *lease;
+  }
+
+  template <typename T>
+  void add_relaxed(std::atomic<T> & x, const T d)
+  {
+    x.store(x.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+  }
+}
+
+const char * profile_stage_name(const ProfileStage stage)
+{
+  switch(stage)
+  {
+    case ProfileStage::camera_setup: return "camera_setup";
+    case ProfileStage::coarse_visibility: return "coarse_visibility";
+    case ProfileStage::rows: return "rows";
+    case ProfileStage::primary_rays: return "primary_rays";
+    case ProfileStage::first_hit: return "first_hit";
+    case ProfileStage::shading: return "shading";
+    case ProfileStage::shadow_rays: return "shadow_rays";
+    case ProfileStage::reflection: return "reflection";
+    case ProfileStage::pixel_packing: return "pixel_packing";
+    case ProfileStage::texture_upload: return "texture_upload";
+    case ProfileStage::present: return "present";
+    default: return "unknown";
+  }
+}
+
+ProfileScope::ProfileScope(const ProfileStage stage_)
+  : stage(stage_)
+{
+  ThreadProfile & tp = this_thread_profile();
+  parent = tp.current;
+  tp.current = this;
+  tp.active[static_cast<int>(stage)]++;
+  start = Clock::now();
+}
+
+ProfileScope::~ProfileScope()
+{
+  const Clock::time_point end = Clock::now();
+  const Clock::duration duration = end - start;
+  const int s = static_cast<int>(stage);
+  ThreadProfile & tp = this_thread_profile();
+  add_relaxed<int64_t>(
+    tp.self_ns[s],
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      duration - nested).count());
+  if(--tp.active[s] == 0)
+  {
+    add_relaxed<int64_t>(
+      tp.total_ns[s],
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+  }
+  add_relaxed<uint64_t>(tp.calls[s], 1);
+  if(parent)
+  {
+    parent->nested += duration;
+  }
+  tp.current = parent;
+
+  Registry & r = registry();
+  if(traced(s) && r.tracing.load(std::memory_order_relaxed) &&
+     r.num_events.fetch_add(1, std::memory_order_relaxed) < max_trace_events)
+  {
+    std::lock_guard<std::mutex> lock(tp.events_mutex);
+    tp.events.push_back({s, to_us(start - r.epoch), to_us(duration)});
+  }
+}
+
+FrameProfile profile_collect()
+{
+  Registry & r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  FrameProfile profile;
+  const Clock::time_point now = Clock::now();
+  profile.wall_ms = 1e-6 *
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+      now - r.last_collect).count();
+  r.last_collect = now;
+  r.threads.for_each([&](size_t, ThreadProfile & tp)
+  {
+    for(int s = 0; s < num_profile_stages; s++)
+    {
+      const int64_t self_ns = tp.self_ns[s].load(std::memory_order_relaxed);
+      const int64_t total_ns = tp.total_ns[s].load(std::memory_order_relaxed);
+      const uint64_t calls = tp.calls[s].load(std::memory_order_relaxed);
+      profile.self_ms[s] += 1e-6 * (self_ns - tp.seen_self_ns[s]);
+      profile.total_ms[s] += 1e-6 * (total_ns - tp.seen_total_ns[s]);
+      profile.calls[s] += calls - tp.seen_calls[s];
+      tp.seen_self_ns[s] = self_ns;
+      tp.seen_total_ns[s] = total_ns;
+      tp.seen_calls[s] = calls;
+    }
+  });
+  if(r.tracing.load(std::memory_order_relaxed))
+  {
+    r.counters.emplace_back(to_us(now - r.epoch), profile);
+  }
+  return profile;
+}
+
+void profile_start_trace(const std::string & filename)
+{
+  Registry & r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.trace_filename = filename;
+  r.counters.clear();
+  r.num_events.store(0);
+  r.threads.for_each([](size_t, ThreadProfile & tp)
+  {
+    std::lock_guard<std::mutex> events_lock(tp.events_mutex);
+    tp.events.clear();
+  });
+  r.tracing.store(true);
+}
+
+bool profile_stop_trace()
+{
+  Registry & r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  if(!r.tracing.exchange(false))
+  {
+    return false;
+  }
+  std::ofstream file(r.trace_filename, std::ios::binary);
+  if(!file)
+  {
+    return false;
+  }
+  // Chrome's trace event format: complete ("X") events per scope and
+  // counter ("C") events per collect
+  file << "{\"traceEvents\":[\n";
+  bool first = true;
+  auto separator = [&]() -> const char *
+  {
+    const char * sep = first ? "" : ",\n";
+    first = false;
+    return sep;
+  };
+  char line[256];
+  r.threads.for_each([&](const size_t tid, ThreadProfile & tp)
+  {
+    std::lock_guard<std::mutex> events_lock(tp.events_mutex);
+    for(const TraceEvent & e : tp.events)
+    {
+      std::snprintf(line, sizeof(line),
+        "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,"
+        "\"ts\":%lld,\"dur\":%lld}",
+        profile_stage_name(static_cast<ProfileStage>(e.stage)),
+        static_cast<int>(tid),
+        static_cast<long long>(e.start_us),
+        static_cast<long long>(e.duration_us));
+      file << separator() << line;
+    }
+    tp.events.clear();
+  });
+  for(const auto & counter : r.counters)
+  {
+    file << separator() << "{\"name\":\"self_ms\",\"ph\":\"C\",\"pid\":0,"
+         << "\"ts\":" << counter.first << ",\"args\":{";
+    for(int s = 0; s < num_profile_stages; s++)
+    {
+      std::snprintf(line, sizeof(line), "%s\"%s\":%.3f", s ? "," : "",
+        profile_stage_name(static_cast<ProfileStage>(s)),
+        counter.second.self_ms[s]);
+      file << line;
+    }
+    file << "}}";
+  }
+  r.counters.clear();
+  file << "\n]}\n";
+  return static_cast<bool>(file);
+}
@@ -0,0 +1,108 @@
+#include "ray_stats.h"
+#include "thread_slots.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  struct Registry
+  {
+    ThreadSlots<ThreadRayCounters> threads;
+    // Collector only (under mutex): totals already reported, per thread
+    std::mutex mutex;
+    std::vector<std::array<uint64_t,num_ray_counters> > seen;
+    Clock::time_point last_collect = Clock::now();
+  };
+
+  Registry & registry()
+  {
+    static Registry r;
+    return r;
+  }
+}
+
+const char * ray_counter_name(const RayCounter counter)
+{
+  switch(counter)
+  {
+    case RayCounter::primary_rays: return "primary_rays";
+    case RayCounter::shadow_rays: return "shadow_rays";
+    case RayCounter::reflection_rays: return "reflection_rays";
+    case RayCounter::triangle_tests: return "triangle_tests";
+    case RayCounter::bvh_node_visits: return "bvh_node_visits";
+    case RayCounter::early_outs: return "early_outs";
+    default: return "unknown";
+  }
+}
+
+uint64_t RayStats::rays() const
+{
+  return (*this)[RayCounter::primary_rays] +
+         (*this)[RayCounter::shadow_rays] +
+         (*this)[RayCounter::reflection_rays];
+}
+
+double RayStats::rays_per_second() const
+{
+  return seconds > 0 ? rays() / seconds : 0.0;
+}
+
+double RayStats::tests_per_ray() const
+{
+  const uint64_t n = rays();
+  return n > 0 ? double((*this)[RayCounter::triangle_tests]) / n : 0.0;
+}
+
+RayStats & RayStats::operator+=(const RayStats & other)
+{
+  for(int c = 0; c < num_ray_counters; c++)
+  {
+    counts[c] += other.counts[c];
+  }
+  seconds += other.seconds;
+  return *this;
+}
+
+ThreadRayCounters::ThreadRayCounters()
+{
+  for(auto & c : counts)
+  {
+    c.store(0, std::memory_order_relaxed);
+  }
+}
+
+ThreadRayCounters & this_thread_ray_counters()
+{
+  thread_local ThreadSlots<ThreadRayCounters>::Lease lease(registry().threads);
+  return *lease;
+}
+
+RayStats collect_ray_stats()
+{
+  Registry & r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  RayStats stats;
+  const Clock::time_point now = Clock::now();
+  stats.seconds = std::chrono::duration<double>(now - r.last_collect).count();
+  r.last_collect = now;
+  r.threads.for_each(
+    [&](const size_t t, const ThreadRayCounters & counters)
+    {
+      if(t == r.seen.size())
+      {
+        r.seen.emplace_back();
+        r.seen.back().fill(0);
+      }
+      for(int c = 0; c < num_ray_counters; c++)
+      {
+        const uint64_t total =
+          counters.counts[c].load(std::memory_order_relaxed);
+        stats.counts[c] += total - r.seen[t][c];
+        r.seen[t][c] = total;
+      }
+    });
+  return stats;
+}